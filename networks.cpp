@@ -0,0 +1,213 @@
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+
+// Largest length sorted with a network
+const int NETWORK_MAX = 256;
+
+// Largest network that is fully unrolled,
+// longer vectors are sorted by blocks and then merged
+const int NETWORK_BLOCK = 32;
+
+
+// Number of comparators in Batcher's odd-even merge sort network for n elements,
+// comparators going beyond the end are dropped
+constexpr int networkSize(int n) {
+  int c = 0;
+  for (int p = 1; p < n; p <<= 1)
+    for (int k = p; k >= 1; k >>= 1)
+      for (int j = k % p; j + k < n; j += 2*k)
+        for (int i = 0; i < std::min(k, n - j - k); i++)
+          if((i + j) / (2*p) == (i + j + k) / (2*p)) c++;
+  return c;
+}
+
+
+// Comparators of the network for N elements, generated at compile time
+template<int N>
+struct Network {
+  static constexpr int size = networkSize(N);
+
+  std::array<int, size> lo{};
+  std::array<int, size> hi{};
+
+  constexpr Network() {
+    int c = 0;
+    for (int p = 1; p < N; p <<= 1)
+      for (int k = p; k >= 1; k >>= 1)
+        for (int j = k % p; j + k < N; j += 2*k)
+          for (int i = 0; i < std::min(k, N - j - k); i++)
+            if((i + j) / (2*p) == (i + j + k) / (2*p)) {
+              lo[c] = i + j;
+              hi[c] = i + j + k;
+              c++;
+            }
+  }
+};
+
+
+// Branchless compare-exchange of two elements
+inline void compareExchange(int16_t &a, int16_t &b) {
+  int16_t temp = a;
+  a = ( (a > b) ? b : a );
+  b = ( (temp > b) ? temp : b);
+}
+
+
+// Compare-exchange of each element in [from, to) with the one at distance k.
+// The two slices never overlap, since to <= from + k.
+inline void compareExchange(int16_t *vec, ptrdiff_t from, ptrdiff_t to, ptrdiff_t k) {
+  #pragma GCC ivdep
+  for (ptrdiff_t i = from; i < to; i++)
+  {
+    compareExchange(vec[i], vec[i+k]);
+  }
+}
+
+
+// Compare-exchange of x with x+K, only if both are in the same block of size 2p.
+// Unchanged values are written back anyway to keep the loops branchless.
+template<int K>
+inline void maskedExchange(int16_t *vec, ptrdiff_t x, ptrdiff_t p) {
+  bool valid = ((x ^ (x + K)) < 2*p);
+  int16_t a = vec[x], b = vec[x+K];
+  int16_t lo = ( (a > b) ? b : a );
+  int16_t hi = ( (a > b) ? a : b );
+  vec[x] = ( valid ? lo : a );
+  vec[x+K] = ( valid ? hi : b );
+}
+
+
+// Stage with small distance K: slices would be too short to be vectorized,
+// so groups of K comparators are processed together over the assigned range
+template<int K>
+void smallStage(int16_t *vec, ptrdiff_t n, ptrdiff_t p, ptrdiff_t lo, ptrdiff_t hi) {
+  ptrdiff_t end = std::min(hi, n - K);
+  ptrdiff_t off = K % p;
+
+  // First group starting inside the range, the comparators of the previous group
+  // that start inside the range are done here
+  ptrdiff_t j = off + ((std::max<ptrdiff_t>(lo - off, 0) + 2*K - 1) / (2*K)) * (2*K);
+  for (ptrdiff_t x = std::max(lo, j - 2*K); x < std::min(j - K, end); x++)
+  {
+    maskedExchange<K>(vec, x, p);
+  }
+
+  #pragma GCC ivdep
+  for (; j + K <= end; j += 2*K)
+  {
+    for (int i = 0; i < K; i++)
+    {
+      maskedExchange<K>(vec, j + i, p);
+    }
+  }
+  for (ptrdiff_t x = j; x < end; x++)
+  {
+    maskedExchange<K>(vec, x, p);
+  }
+}
+
+
+/**
+ *
+ * Stage (p, k) of Batcher's odd-even merge sort network: compare-exchanges between x and x+k,
+ * for x in [j, j+k) with j = k%p + 2k*t, only between elements in the same block of size 2p.
+ * Only comparators whose first element is in [lo, hi) are performed, comparators beyond
+ * the end are dropped.
+ * @param vec vector to sort
+ * @param n   vector length
+ * @param p   size of the blocks being merged
+ * @param k   distance of the comparators
+ * @param lo  first element of the assigned region
+ * @param hi  end of the assigned region
+ *
+*/
+void networkStage(int16_t *vec, ptrdiff_t n, ptrdiff_t p, ptrdiff_t k, ptrdiff_t lo, ptrdiff_t hi) {
+  if(k == 1) smallStage<1>(vec, n, p, lo, hi);
+  else if(k == 2) smallStage<2>(vec, n, p, lo, hi);
+  else if(k == 4) smallStage<4>(vec, n, p, lo, hi);
+  else {
+    ptrdiff_t off = k % p;
+    ptrdiff_t first = std::max(lo, off);
+    for (ptrdiff_t j = off + ((first - off) / (2*k)) * (2*k); j < hi && j + k < n; j += 2*k)
+    {
+      ptrdiff_t from = std::max(j, lo);
+      ptrdiff_t to = std::min(std::min(j + k, hi), n - k);
+      ptrdiff_t bound = (j / (2*p) + 1) * (2*p);
+
+      compareExchange(vec, from, std::min(to, bound - k), k);
+      compareExchange(vec, std::max(from, bound), to, k);
+    }
+  }
+}
+
+
+// Applies all the comparators of the network, fully unrolled
+template<int N, size_t... C>
+inline void applyNetwork(int16_t *v, std::index_sequence<C...>) {
+  static constexpr Network<N> net;
+  (compareExchange(v[net.lo[C]], v[net.hi[C]]), ...);
+}
+
+
+// Sorts n <= N elements with the network for N elements, on a local copy
+// so it can be kept in registers. Missing elements are filled with the maximum value
+// so they stay at the end
+template<int N>
+void sortNetwork(int16_t *vec, int n) {
+  int16_t v[N];
+
+  for (int i = 0; i < N; i++)
+  {
+    v[i] = (i < n ? vec[i] : INT16_MAX);
+  }
+  applyNetwork<N>(v, std::make_index_sequence<Network<N>::size>());
+  for (int i = 0; i < n; i++)
+  {
+    vec[i] = v[i];
+  }
+}
+
+
+/**
+ *
+ * Stages of Batcher's odd-even merge sort network, starting from sorted blocks of size p_start
+ * (aligned to multiples of p_start) up to the whole vector.
+ * @param vec     vector to sort
+ * @param n       vector length
+ * @param p_start size of the sorted blocks, power of two
+ *
+*/
+void mergeStages(int16_t *vec, int n, int p_start) {
+  for (int p = p_start; p < n; p <<= 1)
+  {
+    for (int k = p; k >= 1; k >>= 1)
+    {
+      networkStage(vec, n, p, k, 0, n);
+    }
+  }
+}
+
+
+/**
+ *
+ * Sorts a vector of at most NETWORK_MAX elements using the smallest network that fits it.
+ * @param vec vector to sort
+ * @param n   vector length
+ *
+*/
+void smallSort(int16_t *vec, int n) {
+  if(n <= 8) sortNetwork<8>(vec, n);
+  else if(n <= 16) sortNetwork<16>(vec, n);
+  else if(n <= NETWORK_BLOCK) sortNetwork<NETWORK_BLOCK>(vec, n);
+  else {
+    for (int b = 0; b < n; b += NETWORK_BLOCK)
+    {
+      sortNetwork<NETWORK_BLOCK>(vec + b, std::min(NETWORK_BLOCK, n - b));
+    }
+    mergeStages(vec, n, NETWORK_BLOCK);
+  }
+}
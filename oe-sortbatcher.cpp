@@ -0,0 +1,226 @@
+/**
+ *
+ * Parallel implementation of Batcher's odd-even merge sort
+ * using only C++ standard mechanisms.
+ *
+ * The network is made of O(log^2 n) stages of independent compare-exchange
+ * operations between elements at distance k. Each thread has a region of the vector
+ * assigned, aligned to the cache line size, and at each stage performs the compare-exchanges
+ * whose first element lies in its region. Stages are separated by a barrier.
+ * Lengths that are not a power of two are handled by dropping the comparators
+ * that go beyond the end of the vector.
+ * Regions are made of blocks of NETWORK_MAX elements, first sorted locally
+ * by the small sorting networks, so the first stages need no barrier.
+ *
+*/
+
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <assert.h>
+#include <thread>
+#include <sched.h>
+#include <algorithm>
+#include <numeric>
+
+#include "utils.cpp"
+#include "networks.cpp"
+#include "verify.cpp"
+
+using hrclock = std::chrono::high_resolution_clock;
+
+std::vector<Range> ranges;      // Ranges to assign work
+
+Barrier *bar1;                  // Barriers between stages,
+Barrier *bar2;                  // used alternately
+
+int nw;                         // Number of workers
+Checksum input;                 // Checksum of the generated keys
+int stages = 0;                 // Number of stages of the network
+
+/**
+ *
+ * Auxiliary function to assign ranges to workers,
+ * each range starts on a cache line and on a NETWORK_MAX block boundary.
+ * @param m      vector length
+ * @param c_size cache line size (in bytes)
+ *
+*/
+void assignRanges(ptrdiff_t m, int c_size) {
+  // Multiple of both, so that the local blocks are the ones merged by the network
+  ptrdiff_t line = std::lcm(std::max(c_size / (int)sizeof(int16_t), 1), NETWORK_MAX);
+  ptrdiff_t range_size = ((m / nw + line - 1) / line) * line;
+
+  for(int i=0; i<nw; i++) {
+    Range range;
+    range.start = std::min(i * range_size, m);
+    range.end   = (i != (nw-1) ? std::min(range.start + range_size, m) : m) - 1;
+    range.l_start = range.start;
+    range.size = range.end - range.start + 1;
+    ranges.push_back(range);
+  }
+}
+
+
+/**
+ *
+ * Initializes vector to sort.
+ * @param vec    vector to initialize
+ * @param seed   seed for random number generation
+ * @param m      vector length
+ * @param max    max value to be present in the initialized vector
+ *
+*/
+void initializeVector(Buffer<int16_t> *vec, int seed, ptrdiff_t m, int max) {
+  srand(seed);
+
+  for (ptrdiff_t i = 0; i < m; i++)
+  {
+    (*vec)[i] = (int16_t)(rand() % max);
+    input.add((*vec)[i]);
+  }
+}
+
+
+/**
+ *
+ * Auxiliary function, used for debugging.
+ * Prints all the elements in a vector.
+ * @param vec vector to print
+ *
+*/
+void printVector(Buffer<int16_t> *vec) {
+  for (size_t i = 0; i < (*vec).size(); i++)
+  {
+    std::cout << (*vec)[i] << " ";
+  }
+  std::cout << "" << std::endl;
+}
+
+
+/**
+ *
+ * Thread function used for sorting the region specified in the assigned range.
+ * @param to_sort vector to sort
+ * @param range   range assigned to this thread
+ * @param id      id of this thread
+ *
+*/
+void batcherSort(Buffer<int16_t> *to_sort, Range range, int id) {
+  ptrdiff_t n = to_sort->size();
+  ptrdiff_t lo = range.start;
+  ptrdiff_t hi = range.end + 1;
+  auto vec = to_sort->data();
+
+  int s = 0;    // Current stage, to choose the barrier
+
+  // Barriers are used as in the odd-even version: dec, dec, inc, inc
+  auto sync = [&]() {
+    Barrier &b = (s % 2 == 0 ? *bar1 : *bar2);
+    if((s / 2) % 2 == 0) b.dec_wait();
+    else b.inc_wait();
+    s++;
+  };
+
+  // Base case: local blocks sorted by the networks
+  for (ptrdiff_t b = lo; b < hi; b += NETWORK_MAX)
+  {
+    smallSort(&vec[b], std::min<ptrdiff_t>(NETWORK_MAX, hi - b));
+  }
+  sync();
+
+  // Merges sorted blocks of size p into blocks of size 2p
+  for (ptrdiff_t p = NETWORK_MAX; p < n; p <<= 1)
+  {
+    for (ptrdiff_t k = p; k >= 1; k >>= 1)
+    {
+      networkStage(vec, n, p, k, lo, hi);
+      sync();
+    }
+  }
+
+  if(id == 0) stages = s;
+}
+
+int main(int argc, char const *argv[])
+{
+
+  if(argc < 5) {
+    std::cout << "Usage: " << argv[0] << " seed len nw cache-line-bytes [max-value]" << std::endl;
+    return -1;
+  }
+
+  int seed = atoi(argv[1]);
+  const ptrdiff_t m = atoll(argv[2]);
+  nw = atoi(argv[3]);
+  int size = atoi(argv[4]);
+
+  // Optional value to specify the maximum value
+  // that can be present in the array to be sorted.
+  // Assuming to use only positive integers just for simplicity
+  int max = INT16_MAX;
+  if(argc == 6)
+    max = atoi(argv[argc-1]);
+
+  bar1 = new Barrier(nw);
+  bar2 = new Barrier(nw);
+
+  std::vector<std::thread> tids;
+#ifdef HUGEPAGES
+  prefault_threads = nw;
+#endif
+  Buffer<int16_t> *to_sort = new Buffer<int16_t>(m);
+  assignRanges(m, size);
+  initializeVector(to_sort, seed, m, max);
+
+  int max_threads = std::thread::hardware_concurrency();
+
+  // Memory events of the sort, to compare the allocation modes
+  PerfCounter tlb(PERF_TYPE_HW_CACHE, DTLB_MISSES);
+  PerfCounter faults(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+  tlb.start();
+  faults.start();
+  auto start = hrclock::now();
+#ifdef DEBUG
+  printVector(to_sort);
+#endif
+  for (int i = 0; i < nw; i++) {
+    tids.push_back(std::thread(batcherSort, to_sort, ranges[i], i));
+    // Thread pinning
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(i % max_threads, &cpuset);  // without % those in excess are free to move
+    pthread_setaffinity_np(tids[i].native_handle(),sizeof(cpu_set_t), &cpuset);
+  }
+
+  for(std::thread& t: tids) {
+    t.join();
+  }
+#ifdef DEBUG
+  printVector(to_sort);
+#endif
+  auto elapsed = hrclock::now() - start;
+  auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  long tlb_misses = tlb.stop();
+  long page_faults = faults.stop();
+
+  std::cout << "Simulation spent: " << usec << " usecs\n";
+  if(tlb_misses >= 0) std::cout << "dTLB load misses: " << tlb_misses << "\n";
+  if(page_faults >= 0) std::cout << "Page faults: " << page_faults << "\n";
+#ifdef HUGEPAGES
+  std::cout << "Huge pages: " << huge_pages << "\n";
+#endif
+  std::cout << "Stages: " << stages << "\n";
+
+  delete(bar1);
+  delete(bar2);
+
+  // Checking that it is a sorted permutation of the input
+  if(!verifySorted(*to_sort, nw, input)) return -1;
+
+  delete(to_sort);
+
+  return 0;
+}
@@ -0,0 +1,363 @@
+/**
+ *
+ * Distributed implementation of Odd-Even sort algorithm.
+ *
+ * The vector is split in contiguous blocks, one for each rank (process).
+ * Each rank sorts its own block, then at each phase pairs of neighbour ranks
+ * exchange their borders and, only if they are out of order, their whole blocks
+ * performing a merge-split: the left rank keeps the lower half, the right one the upper half.
+ * Ranks communicate only through a Transport, so the same protocol runs
+ * over shared memory or TCP. The sort ends when no pair changed during
+ * an even and an odd phase, checked with a global OR over the ranks.
+ * Rank 0 generates the vector: blocks are scattered along the chain of ranks
+ * and the sorted ones are gathered back in the same way, so with TCP
+ * each rank can be started on a different host.
+ *
+*/
+
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <assert.h>
+#include <algorithm>
+#include <sstream>
+#include <sys/wait.h>
+
+#include "transport.cpp"
+#include "networks.cpp"
+#include "verify.cpp"
+
+using hrclock = std::chrono::high_resolution_clock;
+
+int np;                         // Number of ranks
+Checksum input;                 // Checksum of the generated keys
+
+
+/**
+ *
+ * Initializes vector to sort.
+ * @param vec    vector to initialize
+ * @param seed   seed for random number generation
+ * @param m      vector length
+ * @param max    max value to be present in the initialized vector
+ *
+*/
+void initializeVector(std::vector<int16_t> *vec, int seed, ptrdiff_t m, int max) {
+  srand(seed);
+
+  for (ptrdiff_t i = 0; i < m; i++)
+  {
+    (*vec)[i] = (int16_t)(rand() % max);
+    input.add((*vec)[i]);
+  }
+}
+
+
+/**
+ *
+ * Auxiliary function, used for debugging.
+ * Prints all the elements in a vector.
+ * @param vec vector to print
+ *
+*/
+void printVector(std::vector<int16_t> *vec) {
+  for (size_t i = 0; i < (*vec).size(); i++)
+  {
+    std::cout << (*vec)[i] << " ";
+  }
+  std::cout << "" << std::endl;
+}
+
+
+/**
+ *
+ * Auxiliary functions to compute the block owned by a rank,
+ * blocks differ in size by at most one element.
+ *
+*/
+ptrdiff_t blockStart(int rank, ptrdiff_t m) {
+  return rank * (m / np) + std::min<ptrdiff_t>(rank, m % np);
+}
+
+ptrdiff_t blockSize(int rank, ptrdiff_t m) {
+  return m / np + (rank < m % np ? 1 : 0);
+}
+
+
+/**
+ *
+ * Global OR over the flags of all the ranks,
+ * accumulated along the chain of ranks and then sent back.
+ * @param t    transport to use
+ * @param rank rank of the caller
+ * @param flag local flag
+ *
+*/
+int16_t allReduceOr(Transport &t, int rank, int16_t flag) {
+  int16_t other;
+
+  if(rank != 0) {
+    t.recv(rank-1, &other, sizeof(other));
+    flag |= other;
+  }
+  if(rank != np-1) {
+    t.send(rank+1, &flag, sizeof(flag));
+    t.recv(rank+1, &flag, sizeof(flag));
+  }
+  if(rank != 0) {
+    t.send(rank-1, &flag, sizeof(flag));
+  }
+  return flag;
+}
+
+
+/**
+ *
+ * Sends a buffer to a neighbour and receives one from it.
+ * The lower rank sends first, so that channels with limited capacity cannot deadlock.
+ *
+*/
+void exchange(Transport &t, int rank, int other, const int16_t *out, ptrdiff_t n_out, int16_t *in, ptrdiff_t n_in) {
+  if(rank < other) {
+    t.send(other, out, n_out * sizeof(int16_t));
+    t.recv(other, in, n_in * sizeof(int16_t));
+  }
+  else {
+    t.recv(other, in, n_in * sizeof(int16_t));
+    t.send(other, out, n_out * sizeof(int16_t));
+  }
+}
+
+
+/**
+ *
+ * Compare-split step with the neighbour rank.
+ * Border elements are exchanged first, whole blocks only if they are out of order.
+ * @param t     transport to use
+ * @param rank  rank of the caller
+ * @param other neighbour rank
+ * @param block block owned by the caller, sorted
+ * @param aux   auxiliary block of the same size
+ * @param m     vector length
+ * @return 1 if the block changed, 0 otherwise
+ *
+*/
+int16_t mergeSplit(Transport &t, int rank, int other, std::vector<int16_t> &block, std::vector<int16_t> &aux, ptrdiff_t m) {
+  ptrdiff_t size = block.size();
+  ptrdiff_t o_size = blockSize(other, m);
+  bool left = rank < other;
+
+  // Phase 1: borders
+  int16_t border = (left ? block.back() : block.front());
+  int16_t o_border;
+  exchange(t, rank, other, &border, 1, &o_border, 1);
+  if(left ? border <= o_border : o_border <= border) return 0;
+
+  // Phase 2: whole blocks
+  std::vector<int16_t> recv(o_size);
+  exchange(t, rank, other, block.data(), size, recv.data(), o_size);
+
+  if(left) {
+    // Keep the lowest elements, merging from the front
+    ptrdiff_t i = 0, j = 0;
+    for (ptrdiff_t k = 0; k < size; k++)
+    {
+      aux[k] = (j == o_size || (i < size && block[i] <= recv[j]) ? block[i++] : recv[j++]);
+    }
+  }
+  else {
+    // Keep the highest elements, merging from the back
+    ptrdiff_t i = size-1, j = o_size-1;
+    for (ptrdiff_t k = size-1; k >= 0; k--)
+    {
+      aux[k] = (j < 0 || (i >= 0 && block[i] > recv[j]) ? block[i--] : recv[j--]);
+    }
+  }
+  block.swap(aux);
+  return 1;
+}
+
+
+/**
+ *
+ * Actual implementation of the Odd-Even sort algorithm, executed by each rank.
+ * @param t     transport to use
+ * @param rank  rank of the caller
+ * @param block block owned by the rank, sorted in place
+ * @param m     vector length
+ *
+*/
+void oddEvenSort(Transport &t, int rank, std::vector<int16_t> &block, ptrdiff_t m) {
+  std::vector<int16_t> aux(block.size());
+
+  // Every rank is connected before starting the clock
+  allReduceOr(t, rank, 0);
+  auto t_start = hrclock::now();
+
+  // Small blocks are sorted by a network
+  if(block.size() <= NETWORK_MAX) smallSort(block.data(), block.size());
+  else std::sort(std::begin(block), std::end(block));
+
+  while(true) {
+    int16_t test = 0;   // Auxiliary variable to check swaps.
+
+    // Phase 1: even phase, rank pairs (0,1), (2,3), ...
+    int other = (rank % 2 == 0 ? rank+1 : rank-1);
+    if(other >= 0 && other < np) test |= mergeSplit(t, rank, other, block, aux, m);
+
+    // Phase 2: odd phase, rank pairs (1,2), (3,4), ...
+    other = (rank % 2 == 0 ? rank-1 : rank+1);
+    if(other >= 0 && other < np) test |= mergeSplit(t, rank, other, block, aux, m);
+
+    if(!allReduceOr(t, rank, test)) break;
+  }
+
+  if(rank == 0) {
+    auto elapsed = hrclock::now() - t_start;
+    auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    std::cout << "Simulation spent: " << usec << " usecs\n";
+  }
+}
+
+
+/**
+ *
+ * Work of a rank: rank 0 generates the vector and sends the blocks of the other ranks
+ * to rank 1, each rank keeps its own block and forwards the following ones.
+ * Once sorted, each rank sends back its block followed by the ones received from its right,
+ * so rank 0 gets the whole sorted vector and checks it.
+ * @param t    transport to use, attached to the rank
+ * @param rank rank of the caller
+ * @param seed seed for random number generation
+ * @param m    vector length
+ * @param max  max value to be present in the vector
+ * @return -1 if rank 0 found the gathered vector not sorted, 0 otherwise
+ *
+*/
+int runRank(Transport &t, int rank, int seed, ptrdiff_t m, int max) {
+  ptrdiff_t start = blockStart(rank, m);
+  ptrdiff_t size = blockSize(rank, m);
+
+  // Blocks of this rank and of the ones on its right
+  std::vector<int16_t> vec(m - start);
+
+  if(rank == 0) {
+    initializeVector(&vec, seed, m, max);
+#ifdef DEBUG
+    printVector(&vec);
+#endif
+  }
+  else t.recv(rank-1, vec.data(), vec.size() * sizeof(int16_t));
+  if(rank != np-1) t.send(rank+1, vec.data() + size, (vec.size() - size) * sizeof(int16_t));
+
+  std::vector<int16_t> block(std::begin(vec), std::begin(vec) + size);
+  oddEvenSort(t, rank, block, m);
+
+  std::copy(std::begin(block), std::end(block), std::begin(vec));
+  if(rank != np-1) t.recv(rank+1, vec.data() + size, (vec.size() - size) * sizeof(int16_t));
+  if(rank != 0) {
+    t.send(rank-1, vec.data(), vec.size() * sizeof(int16_t));
+    return 0;
+  }
+
+  #ifdef DEBUG
+    std::cout << "Final sorted vector is: ";
+    printVector(&vec);
+  #endif
+
+  // Checking that it is a sorted permutation of the input
+  return (verifySorted(vec, np, input) ? 0 : -1);
+}
+
+int main(int argc, char const *argv[])
+{
+
+  if(argc < 5 || (argc > 6 && argc != 9)) {
+    std::cout << "Usage: " << argv[0] << " seed len np shm|tcp [max-value [rank hosts base-port]]" << std::endl;
+    std::cout << "Without rank all the ranks run on this host, otherwise only the given one does:" << std::endl;
+    std::cout << "hosts lists the host of each rank (comma separated), rank r listens on base-port + r" << std::endl;
+    return -1;
+  }
+
+  int seed = atoi(argv[1]);
+  const ptrdiff_t m = atoll(argv[2]);
+  np = atoi(argv[3]);
+  std::string type = argv[4];
+
+  // Optional value to specify the maximum value
+  // that can be present in the array to be sorted.
+  // Assuming to use only positive integers just for simplicity
+  int max = INT16_MAX;
+  if(argc >= 6)
+    max = atoi(argv[5]);
+
+  if(m < np) {
+    std::cout << "Each rank must own at least one element" << std::endl;
+    return -1;
+  }
+
+  // Rank run on its own, the other ones are started on their hosts
+  int rank = -1;
+  std::vector<std::string> hosts(np, "127.0.0.1");
+  int base = 20000 + getpid() % 20000;
+  if(argc == 9) {
+    rank = atoi(argv[6]);
+    std::stringstream list(argv[7]);
+    hosts.clear();
+    for(std::string host; std::getline(list, host, ',');) hosts.push_back(host);
+    base = atoi(argv[8]);
+
+    if(type != "tcp" || rank < 0 || rank >= np || hosts.size() != (size_t)np) {
+      std::cout << "A single rank needs the tcp transport and the host of each of the " << np << " ranks" << std::endl;
+      return -1;
+    }
+  }
+
+  Transport *t;
+  if(type == "shm") t = new ShmTransport(np);
+  else if(type == "tcp") t = new TcpTransport(np, hosts, base);
+  else {
+    std::cout << "Unknown transport: " << type << std::endl;
+    return -1;
+  }
+
+  if(rank >= 0) {
+    t->attach(rank);
+    int rc = runRank(*t, rank, seed, m, max);
+    delete(t);
+    return rc;
+  }
+
+  // All the ranks on this host, this process is rank 0
+  std::cout.flush();
+  std::vector<pid_t> pids;
+  for (int i = 1; i < np; i++) {
+    pid_t pid = fork();
+    if(pid == 0) {
+      t->attach(i);
+      runRank(*t, i, seed, m, max);
+      std::cout.flush();
+      _exit(0);
+    }
+    pids.push_back(pid);
+  }
+
+  t->attach(0);
+  int rc = runRank(*t, 0, seed, m, max);
+
+  int failed = 0;
+  for(pid_t pid: pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+  }
+  delete(t);
+
+  if(failed) {
+    std::cout << failed << " ranks failed" << std::endl;
+    return -1;
+  }
+
+  return rc;
+}
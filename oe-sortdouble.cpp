@@ -11,17 +11,21 @@
 #include <assert.h>
 #include <algorithm>
 
+#include "verify.cpp"
+
 using hrclock = std::chrono::high_resolution_clock;
 using now = std::chrono::_V2::system_clock::time_point;
 
 // Stats counters
-  int phase1 = 0;
-  int n_1 = 0;
-  int phase2 = 0;
-  int n_2 = 0;
-  int overhead = 0;
+  long phase1 = 0;
+  long n_1 = 0;
+  long phase2 = 0;
+  long n_2 = 0;
+  long overhead = 0;
   now time_s, time_e;
 
+Checksum input;             // Checksum of the generated keys
+
 
 /**
  * 
@@ -32,15 +36,20 @@ using now = std::chrono::_V2::system_clock::time_point;
  * @param max    max value to be present in the initialized vector
  * 
 */
-void initializeVector(std::vector<int16_t> *vec_even, std::vector<int16_t> *vec_odd, int seed, int m, int max) {
+void initializeVector(std::vector<int16_t> *vec_even, std::vector<int16_t> *vec_odd, int seed, ptrdiff_t m, int max) {
   srand(seed);
 
-  for (int i = 0; i < m/2; i++)
+  for (ptrdiff_t i = 0; i < m/2; i++)
   {
     (*vec_even)[i] = (int16_t)(rand() % max);
     (*vec_odd)[i] = (int16_t)(rand() % max);
+    input.add((*vec_even)[i]);
+    input.add((*vec_odd)[i]);
 
-    if(i==(m/2)-1 && m%2==1) (*vec_even)[i+1] = (int16_t)(rand() % max);
+    if(i==(m/2)-1 && m%2==1) {
+      (*vec_even)[i+1] = (int16_t)(rand() % max);
+      input.add((*vec_even)[i+1]);
+    }
   }
 }
 
@@ -54,7 +63,7 @@ void initializeVector(std::vector<int16_t> *vec_even, std::vector<int16_t> *vec_
 */
 void printVector(std::vector<int16_t> *vec) {
 
-  for (int i = 0; i < (*vec).size(); i++)
+  for (size_t i = 0; i < (*vec).size(); i++)
   {
     std::cout << (*vec)[i] << " ";
   }
@@ -69,12 +78,12 @@ void printVector(std::vector<int16_t> *vec) {
  * @param m       vector length
  * 
 */
-void oddEvenSort(std::vector<int16_t> *even, std::vector<int16_t> *odd, int m) {
+void oddEvenSort(std::vector<int16_t> *even, std::vector<int16_t> *odd, ptrdiff_t m) {
   auto &vec_even = *even;
   auto &vec_odd = *odd;
 
-  int even_end = vec_odd.size();
-  int odd_end = vec_even.size()-1;
+  ptrdiff_t even_end = vec_odd.size();
+  ptrdiff_t odd_end = vec_even.size()-1;
 
   now start = hrclock::now();
   while(true) {
@@ -83,7 +92,7 @@ void oddEvenSort(std::vector<int16_t> *even, std::vector<int16_t> *odd, int m) {
     // Phase 1: even phase
     time_s = hrclock::now();
     #pragma GCC ivdep
-    for (int i = 0; i < even_end; i++)
+    for (ptrdiff_t i = 0; i < even_end; i++)
     {
       int16_t first = vec_even[i];
       int16_t second = vec_odd[i];
@@ -103,7 +112,7 @@ void oddEvenSort(std::vector<int16_t> *even, std::vector<int16_t> *odd, int m) {
     // Phase 2: odd phase
     time_s = hrclock::now();
     #pragma GCC ivdep
-    for (int i = 0; i < odd_end; i++)
+    for (ptrdiff_t i = 0; i < odd_end; i++)
     {
       int16_t first = vec_odd[i];
       int16_t second = vec_even[i+1];
@@ -141,7 +150,7 @@ int main(int argc, char const *argv[])
   }
 
   int seed = atoi(argv[1]);
-  const int m = atoi(argv[2]);
+  const ptrdiff_t m = atoll(argv[2]);
   
   // Optional value to specify the maximum value
   // that can be present in the array to be sorted.
@@ -172,7 +181,7 @@ int main(int argc, char const *argv[])
   std::cout << "OH per cicle: " << (float)overhead/(float)(n_1*2) << std::endl;
 
   std::vector<int16_t> sorted;
-  for (int i = 0; i < to_sort_odd->size(); i++)
+  for (size_t i = 0; i < to_sort_odd->size(); i++)
   {
     sorted.push_back((*to_sort_even)[i]);
     sorted.push_back((*to_sort_odd)[i]);
@@ -184,8 +193,8 @@ int main(int argc, char const *argv[])
   printVector(&sorted);
   #endif
 
-  // Checking if it is really sorted
-  assert(std::is_sorted(std::begin(sorted), std::end(sorted)));
+  // Checking that it is a sorted permutation of the input
+  if(!verifySorted(sorted, 1, input)) return -1;
 
   // delete(to_sort);
 
@@ -9,6 +9,14 @@
  * Workers updates task test condition and for each task received
  * sort the assigned region until EOS is received.
  * 
+ * When compiled with -DDIRTY=b, workers skip the blocks of b elements
+ * that did not change in the previous phase, as in the C++ threads version.
+ * 
+ * When compiled with -DSPECULATE=k, each task covers several iterations (at most k),
+ * in which workers synchronize only with their neighbours. The Master checks termination
+ * at the end of each task, doubling the iterations of the next one while more than a quarter
+ * of the workers are still swapping, halving them otherwise.
+ * 
 */
 
 
@@ -22,6 +30,7 @@
 #include <ff/farm.hpp>
 
 #include "utils.cpp"
+#include "verify.cpp"
 
 using namespace ff;
 using hrclock = std::chrono::high_resolution_clock;
@@ -31,6 +40,16 @@ std::vector<Task*> *tasks;      // Tasks being assigned to workers
 std::vector<int16_t> *to_sort;  // Vector to sort
 
 int nw;                         // Number of workers
+Checksum input;                 // Checksum of the generated keys
+
+#ifdef DIRTY
+static_assert(DIRTY > 0 && DIRTY % 2 == 0, "Blocks must start on even pairs");
+#endif
+
+#ifdef SPECULATE
+std::vector<WorkerPhase> phases;  // Phases completed by each worker
+int spec_checks = 0;              // Number of termination checks
+#endif
 
 
 /**
@@ -38,7 +57,7 @@ int nw;                         // Number of workers
  * Auxiliary function to assign ranges to workers
  * 
 */
-void assignRanges(int m) {
+void assignRanges(ptrdiff_t m) {
   auto range_size = m / nw;
   auto rem = m % nw;
 
@@ -70,7 +89,7 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size)
   
   for (int i = 0; i < nw; i++)
   {
-    int inter_size = ranges[i].end - ranges[i].start + 1;
+    ptrdiff_t inter_size = ranges[i].end - ranges[i].start + 1;
     ranges[i].size = (i==nw-1 ? inter_size-1 : inter_size);
     ranges[i].l_start = vec->size();
     int pad = ((c_size - (2*(inter_size+1)%c_size))/2)%32;
@@ -80,15 +99,17 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size)
       vec->push_back(back);
       inter_size--;
     }
-    for (int k = 0; k <= inter_size-1; k++)
+    for (ptrdiff_t k = 0; k <= inter_size-1; k++)
     {
       int16_t el = (int16_t)(rand() % max);
       vec->push_back(el);
+      input.add(el);
     }
     // If not last worker, save the next element in the current region
     if(i!=nw-1) {
       back = (int16_t)(rand() % max);
       vec->push_back(back);
+      input.add(back);
       // Add padding
       for (int i = 0; i < pad; i++)
       {
@@ -108,7 +129,7 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size)
  * 
 */
 void printVector(std::vector<int16_t> *vec) {
-  for (int i = 0; i < (*vec).size(); i++)
+  for (size_t i = 0; i < (*vec).size(); i++)
   {
     std::cout << (*vec)[i] << " ";
   }
@@ -121,6 +142,9 @@ struct Master: ff_monode_t<Task> {
   int ntask = 0;        // Variable to check current active workers
   int16_t test = 0;     // Variable to check termination
   ff_loadbalancer *lb;  // Load balancer to retrieve channel id
+#ifdef SPECULATE
+  int period = 1;       // Iterations in each task
+#endif
 
   Master(ff_loadbalancer* const lb): lb(lb) {}
 
@@ -139,6 +163,31 @@ struct Master: ff_monode_t<Task> {
     
     test += task->test;
     ntask--;
+
+#ifdef SPECULATE
+    // Tasks cover both phases, test is the one of the last odd phase
+    if(ntask == 0) {
+      spec_checks++;
+      if(test == 0) {
+        for (int i = 0; i < nw; i++)
+        {
+          delete((*tasks)[i]);
+        }
+        return EOS;
+      }
+
+      period = (4*test > nw ? std::min(2*period, SPECULATE) : std::max(period/2, 1));
+      test = 0;
+      for (int i = 0; i < nw; i++)
+      {
+        ntask++;
+        (*tasks)[i]->test = 0;
+        (*tasks)[i]->iters = period;
+        ff_send_out_to((*tasks)[i], i);
+      }
+    }
+    return GO_ON;
+#endif
     
     // Reached exit condition
     if(task->phase == 1 && test == 0 && ntask == 0)  {
@@ -168,80 +217,130 @@ struct Master: ff_monode_t<Task> {
 
 struct Worker: ff_node_t<Task> {
 
-  int size, l_start, l_end, id;
+  ptrdiff_t size, l_start, l_end;
+  int id;
   std::vector<int16_t> *vec_to_sort;
+#ifdef SPECULATE
+  long q = 0;         // Phases completed
+#endif
+#ifdef DIRTY
+  // Swaps of each block in the previous and in the current phase,
+  // with an always dirty block on both sides
+  ptrdiff_t blocks;
+  std::vector<int16_t> last, curr;
+  int forced = 2;     // Phases sorting all the blocks, so that each pair is checked once
+#endif
 
   Worker(int id) : id(id) {
     size = ranges[id].size;
     l_start = ranges[id].l_start;
     l_end = l_start+ranges[id].size;
+#ifdef DIRTY
+    blocks = (size + DIRTY - 1) / DIRTY;
+    last.assign(blocks+2, 1);
+    curr.assign(blocks+2, 1);
+#endif
 
     // Create local vector to sort
     vec_to_sort = new std::vector<int16_t>(size+1);
     std::copy_n(std::begin(*to_sort)+l_start, size+1, std::begin(*vec_to_sort));
   }
 
+  // Sorts the pairs of the region starting at lo+phase, lo+phase+2, ... before hi,
+  // returns 1 if at least one pair was swapped
+  int16_t sortPairs(std::vector<int16_t> &local_vec, ptrdiff_t lo, ptrdiff_t hi, int phase) {
+    int16_t swaps = 0;
+
+    #pragma GCC ivdep
+    for (ptrdiff_t i = lo+phase; i < hi; i+=2)
+    {
+      int16_t first = local_vec[i];
+      int16_t second = local_vec[i+1];
+
+      // Swapping values
+      int16_t temp = first;
+      first = ( (first > second) ? second : first );
+      second = ( (temp > second) ? temp : second);
+
+      local_vec[i] = first;
+      local_vec[i+1] = second;
+
+      swaps = swaps | (temp > first);
+    }
+    return swaps;
+  }
+
   Task* svc(Task* task) {
 
-    Task &t = *task;
+#ifdef SPECULATE
+    for (int it = 0; it < task->iters; it++)
+    {
+      // The previous worker completed its odd phase
+      if(id != 0) phases[id-1].wait(q);
+      sortPhase(0);
+      phases[id].done = ++q;
+
+      // The next worker completed its even phase
+      if(id != nw-1) phases[id+1].wait(q);
+      task->test = sortPhase(1);
+      phases[id].done = ++q;
+    }
+#else
+    task->test = sortPhase(task->phase);
+#endif
+    return task;
+
+  }
+
+  // Sorts the assigned region in the given phase, returns 1 if there were swaps in the odd phase
+  int16_t sortPhase(int phase) {
+
     auto &vec = *to_sort;
     auto &local_vec = *vec_to_sort;
     int16_t test = 0;
 
     // Prepare next phase, updates first/last element
-    if(id!=0 && (task->phase == 0)) {
+    if(id!=0 && (phase == 0)) {
       local_vec[0] = vec[ranges[id-1].l_start + ranges[id-1].size];
     }
 
-    if(id != nw-1 && (task->phase == 1)) {
+    if(id != nw-1 && (phase == 1)) {
       local_vec[size] = vec[ranges[id+1].l_start];
     }
 
-    if(task->phase == 0){
-      #pragma GCC ivdep
-      for (int i = 0; i < size; i+=2)
-      {
-        int16_t first = local_vec[i];
-        int16_t second = local_vec[i+1];
-
-        // Swapping values
-        int16_t temp = first;
-        first = ( (first > second) ? second : first );
-        second = ( (temp > second) ? temp : second);
-
-        local_vec[i] = first;
-        local_vec[i+1] = second;
+#ifdef DIRTY
+    // Blocks unchanged, together with their neighbours, in the previous phase are skipped
+    for (ptrdiff_t b = 0; b < blocks; b++)
+    {
+      if(!forced && !(last[b] | last[b+1] | last[b+2])) {
+        curr[b+1] = 0;
+        continue;
       }
+      ptrdiff_t lo = b*DIRTY;
+      curr[b+1] = sortPairs(local_vec, lo, std::min(lo+DIRTY, size), phase);
+      test = test | curr[b+1];
     }
-    else {
-      #pragma GCC ivdep
-      for (int i = 1; i < size; i+=2)
-      {
-        int16_t first = local_vec[i];
-        int16_t second = local_vec[i+1];
-
-        // Swapping values
-        int16_t temp = first;
-        first = ( (first > second) ? second : first );
-        second = ( (temp > second) ? temp : second);
-
-        local_vec[i] = first;
-        local_vec[i+1] = second;
+    last.swap(curr);
+    forced -= (forced > 0);
+#else
+    test = sortPairs(local_vec, 0, size, phase);
+#endif
+    // Only the odd phase decides termination
+    if(phase == 0) test = 0;
 
-        test = test | (temp > first);
-      }
-    }
     // Updates border elements
     vec[l_start] = local_vec[0];
     vec[l_end] = local_vec[size];
 
-    task->test = test;
-    return task;
+    return test;
 
   }
 
+  // Sorted region is written directly to its logical position, without padding.
+  // Other workers no longer read the shared vector, they are all done with their tasks
   void svc_end() {
-    std::copy_n(std::begin(*vec_to_sort), size, std::begin(*to_sort)+l_start);
+    ptrdiff_t n = size + (id == nw-1 ? 1 : 0);
+    std::copy_n(std::begin(*vec_to_sort), n, std::begin(*to_sort)+ranges[id].start);
     delete(vec_to_sort);
   }
 
@@ -257,7 +356,7 @@ int main(int argc, char const *argv[])
   }
 
   int seed = atoi(argv[1]);
-  const int m = atoi(argv[2]);
+  const ptrdiff_t m = atoll(argv[2]);
   nw = atoi(argv[3]);
   int size = atoi(argv[4]);
 
@@ -271,6 +370,9 @@ int main(int argc, char const *argv[])
 
   to_sort = new std::vector<int16_t>();
   tasks = new std::vector<Task*>(nw);
+#ifdef SPECULATE
+  phases = std::vector<WorkerPhase>(nw);
+#endif
   assignRanges(m);
   initializeVector(to_sort, seed, max, size);
 
@@ -294,6 +396,8 @@ int main(int argc, char const *argv[])
     return -1;
   }
 
+  // For odd lengths the last range ends on an even index, with one more key
+  to_sort->resize(ranges.back().end + 1);
 #ifdef DEBUG
   printVector(to_sort);
 #endif
@@ -301,28 +405,21 @@ int main(int argc, char const *argv[])
   auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
 
   std::cout << "Simulation spent: " << usec << " usecs\n";
+#ifdef SPECULATE
+  std::cout << "Termination checks: " << spec_checks << "\n";
+#endif
 
-  // Building sorted vector
-  std::vector<int16_t> sorted;
-  for (int i = 0; i < nw; i++)
-  {
-    for (int j = ranges[i].l_start; j < ranges[i].l_start+ranges[i].size; j++)
-    {
-      sorted.push_back((*to_sort)[j]);
-      if(i==nw-1 && j==(ranges[i].l_start+ranges[i].size-1)) sorted.push_back((*to_sort)[j+1]);
-    }
-    
-  }
+  // Workers already wrote the sorted vector without padding
   #ifdef DEBUG
     std::cout << "Final sorted vector is: ";
-    printVector(&sorted);
+    printVector(to_sort);
   #endif
 
+  // Checking that it is a sorted permutation of the input
+  if(!verifySorted(*to_sort, nw, input)) return -1;
+
   delete(to_sort);
   delete(tasks);
 
-  // Checking if it is really sorted
-  assert(std::is_sorted(std::begin(sorted), std::end(sorted)));
-
   return 0;
 }
@@ -0,0 +1,279 @@
+/**
+ *
+ * Parallel implementation of Odd-Even sort algorithm
+ * using OpenMP.
+ *
+ * Same padded-range layout of the C++ threads version: a single persistent
+ * parallel region is opened, each thread keeps working on the same region
+ * (iteration w of every worksharing loop goes to thread w) and phases are
+ * separated by the implicit barriers of the worksharing loops.
+ * Termination is decided by an OR-reduction on the swaps of the odd phase.
+ *
+*/
+
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <assert.h>
+#include <algorithm>
+#include <omp.h>
+
+#include "utils.cpp"
+#include "verify.cpp"
+
+using hrclock = std::chrono::high_resolution_clock;
+
+std::vector<Range> ranges;      // Ranges to assign work
+
+int nw;                         // Number of workers
+Checksum input;                 // Checksum of the generated keys
+
+/**
+ *
+ * Auxiliary function to assign ranges to workers
+ *
+*/
+void assignRanges(ptrdiff_t m) {
+  auto range_size = m / nw;
+
+  for(int i=0; i<nw; i++) {
+    Range range;
+    range.start = (i==0 ? 0 : ranges.back().end + 1);
+    range.end   = (i != (nw-1) ? range.start+range_size - 1 : m-1);
+
+    if(range.end%2 == 0) range.end++;
+    ranges.push_back(range);
+  }
+}
+
+
+/**
+ *
+ * Initializes vector to sort with padding,
+ * based on the number of workers and on cache line size.
+ * It initializes also the ranges to assign to each worker with the indexes to access
+ * the vector.
+ * @param vec    vector to initialize
+ * @param seed   seed for random number generation
+ * @param max    max value to be present in the initialized vector
+ * @param c_size cache line size (in bytes) used for padding
+ *
+*/
+void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size) {
+  srand(seed);
+
+  for (int i = 0; i < nw; i++)
+  {
+    // Assigning new start based on padding
+    ptrdiff_t inter_size = ranges[i].end - ranges[i].start + 1;
+    ranges[i].size = (i==nw-1 ? inter_size-1 : inter_size);
+    ranges[i].l_start = vec->size();
+    int pad = ((c_size - (2*(inter_size+1)%c_size))/2)%32;
+
+    int16_t back;
+    if(i!=0) {
+      vec->push_back(back);
+      inter_size--;
+    }
+    for (ptrdiff_t k = 0; k <= inter_size-1; k++)
+    {
+      int16_t el = (int16_t)(rand() % max);
+      vec->push_back(el);
+      input.add(el);
+    }
+    // If not last worker, save the next element in the current region
+    if(i!=nw-1) {
+      back = (int16_t)(rand() % max);
+      vec->push_back(back);
+      input.add(back);
+      // Add padding
+      for (int i = 0; i < pad; i++)
+      {
+        vec->push_back(-1);
+      }
+    }
+
+  }
+}
+
+
+/**
+ *
+ * Auxiliary function, used for debugging.
+ * Prints all the elements in a vector.
+ * @param vec vector to print
+ *
+*/
+void printVector(std::vector<int16_t> *vec) {
+  for (size_t i = 0; i < (*vec).size(); i++)
+  {
+    std::cout << (*vec)[i] << " ";
+  }
+  std::cout << "" << std::endl;
+}
+
+
+/**
+ *
+ * Actual implementation of the Odd-Even sort algorithm.
+ * The whole sort runs in one parallel region of nw threads.
+ * @param to_sort vector to sort
+ *
+*/
+void oddEvenSort(std::vector<int16_t> *to_sort) {
+  auto &vec = *to_sort;
+
+  // Exit condition, two copies alternated between iterations so that
+  // one can be reset while the other one is still being read
+  int16_t cond[2] = {0, 0};
+
+  #pragma omp parallel num_threads(nw) shared(vec, cond)
+  {
+    int p = 0;
+
+    while(true) {
+
+      // Phase 1: even phase
+      #pragma omp for schedule(static, 1)
+      for (int w = 0; w < nw; w++)
+      {
+        auto local_vec = &vec[ranges[w].l_start];
+        ptrdiff_t size = ranges[w].size;
+
+        // Prepare for even phase, updates first element
+        if(w!=0) {
+          local_vec[0] = vec[ranges[w-1].l_start + ranges[w-1].size];
+        }
+
+        #pragma GCC ivdep
+        for (ptrdiff_t i = 0; i < size; i+=2)
+        {
+          int16_t first = local_vec[i];
+          int16_t second = local_vec[i+1];
+
+          // Swapping values
+          int16_t temp = first;
+          first = ( (first > second) ? second : first );
+          second = ( (temp > second) ? temp : second);
+
+          local_vec[i] = first;
+          local_vec[i+1] = second;
+        }
+      }
+
+      // Everybody already read the other copy in the previous iteration
+      #pragma omp single nowait
+      cond[p^1] = 0;
+
+      // Phase 2: odd phase
+      #pragma omp for schedule(static, 1) reduction(|:cond[p:1])
+      for (int w = 0; w < nw; w++)
+      {
+        auto local_vec = &vec[ranges[w].l_start];
+        ptrdiff_t size = ranges[w].size;
+        int16_t test = 0;   // Auxiliary variable to check swaps.
+
+        // Prepare for odd phase, updates last element
+        if(w != nw-1) {
+          local_vec[size] = vec[ranges[w+1].l_start];
+        }
+
+        #pragma GCC ivdep
+        for (ptrdiff_t i = 1; i < size; i+=2)
+        {
+          int16_t first = local_vec[i];
+          int16_t second = local_vec[i+1];
+
+          int16_t temp = first;
+          first = ( (first > second) ? second : first );
+          second = ( (temp > second) ? temp : second);
+
+          local_vec[i] = first;
+          local_vec[i+1] = second;
+
+          test = test | (temp > first);
+        }
+        cond[p] |= test;
+      }
+
+      if(cond[p] == 0) break;
+      p ^= 1;
+    }
+  }
+}
+
+int main(int argc, char const *argv[])
+{
+
+  if(argc < 5) {
+    std::cout << "Usage: " << argv[0] << " seed len nw cache-line-bytes [max-value]" << std::endl;
+    return -1;
+  }
+
+  int seed = atoi(argv[1]);
+  const ptrdiff_t m = atoll(argv[2]);
+  nw = atoi(argv[3]);
+  int size = atoi(argv[4]);
+
+  // Optional value to specify the maximum value
+  // that can be present in the array to be sorted.
+  // Assuming to use only positive integers just for simplicity
+  int max = INT16_MAX;
+  if(argc == 6)
+    max = atoi(argv[argc-1]);
+
+  std::vector<int16_t> *to_sort = new std::vector<int16_t>();
+  assignRanges(m);
+  initializeVector(to_sort, seed, max, size);
+
+  // Thread pinning is left to the OpenMP runtime (OMP_PROC_BIND, OMP_PLACES)
+
+  auto start = hrclock::now();
+#ifdef DEBUG
+  printVector(to_sort);
+#endif
+  oddEvenSort(to_sort);
+#ifdef DEBUG
+  printVector(to_sort);
+#endif
+  auto elapsed = hrclock::now() - start;
+  auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+
+  std::cout << "Simulation spent: " << usec << " usecs\n";
+
+  // Removing padding, the sorted vector is built in place:
+  // tails overwritten by the next regions are saved before moving
+  start = hrclock::now();
+  std::vector<std::vector<int16_t>> tails(nw);
+  #pragma omp parallel num_threads(nw)
+  {
+    #pragma omp for schedule(static, 1)
+    for (int w = 0; w < nw; w++)
+    {
+      saveTail(*to_sort, ranges[w], ranges[w].size + (w == nw-1), tails[w]);
+    }
+
+    #pragma omp for schedule(static, 1)
+    for (int w = 0; w < nw; w++)
+    {
+      moveRegion(*to_sort, ranges[w], ranges[w].size + (w == nw-1), tails[w]);
+    }
+  }
+  // For odd lengths the last range ends on an even index, with one more key
+  to_sort->resize(ranges.back().end + 1);
+  elapsed = hrclock::now() - start;
+  usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  std::cout << "Compaction spent: " << usec << " usecs\n";
+  #ifdef DEBUG
+    std::cout << "Final sorted vector is: ";
+    printVector(to_sort);
+  #endif
+
+  // Checking that it is a sorted permutation of the input
+  if(!verifySorted(*to_sort, nw, input)) return -1;
+
+  delete(to_sort);
+
+  return 0;
+}
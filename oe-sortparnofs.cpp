@@ -7,6 +7,34 @@
  * it keeps sorting the same region (switching starting position based on current phase)
  * until the shared exit condition is met.
  * 
+ * When compiled with -DREBALANCE=k, every k iterations the range boundaries
+ * are moved based on the time each worker spent in the phases, so that
+ * faster workers get more elements.
+ * 
+ * When compiled with -DARGSORT, indexes are moved together with the keys
+ * as in the sequential version, giving the sorting permutation.
+ * 
+ * When compiled with -DDIRTY=b, each region is split in blocks of b elements
+ * and a block is skipped when neither it nor its neighbours had swaps in the
+ * previous phase: its pairs were already in order and their elements did not change.
+ * The first even and odd phases sort all the blocks, since no pair was checked yet.
+ * The first and last block of a region are always sorted, since their border
+ * elements are updated by the neighbour workers.
+ * 
+ * When compiled with -DPREPASS, the phases are preceded by comb sort like passes
+ * at decreasing gaps, as in the sequential version. Each worker performs the
+ * compare-exchanges starting in its range, passes are separated by the phase barriers.
+ * 
+ * When compiled with -DSPECULATE=k, phases are synchronized only with the neighbour
+ * workers, and termination is checked with a barrier only every few iterations, at most k.
+ * Extra phases on a sorted vector do nothing, so a late check only wastes some phases.
+ * The checking period doubles while more than a quarter of the workers are still swapping,
+ * and it is halved otherwise, so checks get frequent when only a few regions are left.
+ * 
+ * When compiled with -DSHRINK=k, workers that had no swaps in the last k iterations,
+ * together with their neighbours, are retired: the team stops and the remaining phases
+ * are handed to a smaller one, in which each retired region is merged into an active neighbour.
+ * 
 */
 
 
@@ -20,6 +48,7 @@
 #include <algorithm>
 
 #include "utils.cpp"
+#include "verify.cpp"
 
 using hrclock = std::chrono::high_resolution_clock;
 
@@ -30,13 +59,55 @@ Barrier *bar1;                  // Even phase barrier
 Barrier *bar2;                  // Odd phase barrier
 
 int nw;                         // Number of workers
+Checksum input;                 // Checksum of the generated keys
+
+#ifdef ARGSORT
+Buffer<ptrdiff_t> *indexes;     // Position of each key before sorting, same layout of the keys
+#endif
+
+#if defined(REBALANCE) || defined(SHRINK)
+std::vector<Range> next_ranges;         // Ranges of the next layout
+Buffer<int16_t> *buffers[2];            // Current and next padded layout
+#ifdef ARGSORT
+Buffer<ptrdiff_t> *idx_buffers[2];      // Indexes in the current and next layout
+#endif
+int c_size;                             // Cache line size used for padding
+#endif
+
+#ifdef REBALANCE
+std::vector<WorkerTime> times;          // Time spent in phases by each worker
+Barrier *bar3;                          // Layout switch barrier
+#endif
+
+#ifdef SHRINK
+std::vector<WorkerQuiet> quiet;         // Iterations without swaps of each worker
+int teams = 1;                          // Teams used so far
+#endif
+
+#ifdef SPECULATE
+#if defined(REBALANCE) || defined(SHRINK)
+#error "SPECULATE cannot be used with REBALANCE or SHRINK, they need a barrier at each iteration"
+#endif
+std::vector<WorkerPhase> phases;        // Phases completed by each worker
+std::atomic<int16_t> checks[3];         // Workers with swaps at each check, rotated
+int spec_checks = 0;                    // Number of termination checks
+#endif
+
+#ifdef PREPASS
+long prepass = 0;                       // Time spent in the pre-pass
+int gaps = 0;                           // Number of gaps of the pre-pass
+#endif
+
+#ifdef DIRTY
+static_assert(DIRTY > 0 && DIRTY % 2 == 0, "Blocks must start on even pairs");
+#endif
 
 /**
  * 
  * Auxiliary function to assign ranges to workers
  * 
 */
-void assignRanges(int m) {
+void assignRanges(ptrdiff_t m) {
   auto range_size = m / nw;
   auto rem = m % nw;
 
@@ -63,13 +134,13 @@ void assignRanges(int m) {
  * @param c_size cache size (in bytes) used for padding
  * 
 */
-void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size) {
+void initializeVector(Buffer<int16_t> *vec, int seed, int max, int c_size) {
   srand(seed);
   
   for (int i = 0; i < nw; i++)
   {
     // Assigning new start based on padding
-    int inter_size = ranges[i].end - ranges[i].start + 1;
+    ptrdiff_t inter_size = ranges[i].end - ranges[i].start + 1;
     ranges[i].size = (i==nw-1 ? inter_size-1 : inter_size);
     ranges[i].l_start = vec->size();
     int pad = ((c_size - (2*(inter_size+1)%c_size))/2)%32;
@@ -79,15 +150,17 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size)
       vec->push_back(back);
       inter_size--;
     }
-    for (int k = 0; k <= inter_size-1; k++)
+    for (ptrdiff_t k = 0; k <= inter_size-1; k++)
     {
       int16_t el = (int16_t)(rand() % max);
       vec->push_back(el);
+      input.add(el);
     }
     // If not last worker, save the next element in the current region
     if(i!=nw-1) {
       back = (int16_t)(rand() % max);
       vec->push_back(back);
+      input.add(back);
       // Add padding
       for (int i = 0; i < pad; i++)
       {
@@ -99,6 +172,29 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size)
 }
 
 
+#ifdef ARGSORT
+/**
+ * 
+ * Initializes the indexes with the position of each key in the vector without padding.
+ * Border elements are duplicated as their keys, padding gets -1.
+ * @param idx vector to initialize
+ * @param len length of the padded vector
+ * 
+*/
+void initializeIndexes(Buffer<ptrdiff_t> *idx, ptrdiff_t len) {
+  idx->assign(len, -1);
+
+  for (int i = 0; i < nw; i++)
+  {
+    for (ptrdiff_t k = 0; k <= ranges[i].size; k++)
+    {
+      (*idx)[ranges[i].l_start + k] = ranges[i].start + k;
+    }
+  }
+}
+#endif
+
+
 /**
  * 
  * Auxiliary function, used for debugging.
@@ -106,8 +202,8 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int max, int c_size)
  * @param vec vector to print
  * 
 */
-void printVector(std::vector<int16_t> *vec) {
-  for (int i = 0; i < (*vec).size(); i++)
+void printVector(Buffer<int16_t> *vec) {
+  for (size_t i = 0; i < (*vec).size(); i++)
   {
     std::cout << (*vec)[i] << " ";
   }
@@ -115,6 +211,290 @@ void printVector(std::vector<int16_t> *vec) {
 }
 
 
+#if defined(REBALANCE) || defined(SHRINK)
+/**
+ * 
+ * Computes the padded layout of the next ranges, as in initializeVector,
+ * once their start and end have been set.
+ * 
+*/
+void layoutRanges() {
+  ptrdiff_t l_start = 0;
+  for (size_t i = 0; i < next_ranges.size(); i++)
+  {
+    ptrdiff_t inter_size = next_ranges[i].end - next_ranges[i].start + 1;
+    next_ranges[i].size = (i==next_ranges.size()-1 ? inter_size-1 : inter_size);
+    next_ranges[i].l_start = l_start;
+    int pad = ((c_size - (2*(inter_size+1)%c_size))/2)%32;
+    l_start += next_ranges[i].size + 1 + pad;
+  }
+}
+#endif
+
+
+#ifdef REBALANCE
+/**
+ * 
+ * Computes the next ranges, giving to each worker a share of the vector
+ * proportional to the number of elements it processed per usec since the last rebalancing.
+ * Boundaries are kept even-aligned and the new padded layout is computed as in initializeVector.
+ * 
+*/
+void computeRanges() {
+  ptrdiff_t m = ranges.back().end + 1;
+
+  std::vector<double> speed(nw);
+  double tot = 0;
+  for (int i = 0; i < nw; i++)
+  {
+    speed[i] = (ranges[i].size + 1) / std::max(times[i].usecs, 1e-3);
+    tot += speed[i];
+  }
+
+  for (int i = 0; i < nw; i++)
+  {
+    Range range;
+    range.start = (i==0 ? 0 : next_ranges[i-1].end + 1);
+
+    if(i != nw-1) {
+      // Move halfway towards the measured share to damp oscillations
+      ptrdiff_t old_size = ranges[i].end - ranges[i].start + 1;
+      ptrdiff_t target = (ptrdiff_t)(m * speed[i] / tot);
+      ptrdiff_t inter_size = ((old_size + target) / 2) & ~1;
+
+      // Leave at least two elements to each of the remaining workers
+      inter_size = std::max<ptrdiff_t>(inter_size, 2);
+      inter_size = std::min(inter_size, m - range.start - 2*(nw-1-i));
+      range.end = range.start + inter_size - 1;
+    }
+    else range.end = m-1;
+
+    next_ranges[i] = range;
+  }
+  layoutRanges();
+}
+#endif
+
+
+#if defined(REBALANCE) || defined(SHRINK)
+/**
+ * 
+ * Copies the region assigned to this thread by the next ranges
+ * from the current layout to the spare one.
+ * Called by all the threads after the odd phase, the two layouts are swapped afterwards.
+ * @param id id of this thread
+ * 
+*/
+void migrate(int id) {
+  auto &src = *buffers[0];
+  auto dst = &(*buffers[1])[next_ranges[id].l_start];
+#ifdef ARGSORT
+  auto &idx_src = *idx_buffers[0];
+  auto idx_dst = &(*idx_buffers[1])[next_ranges[id].l_start];
+#endif
+
+  // After the odd phase each border element is up to date in the region
+  // on its left, i.e. logical index x belongs to the region r with start < x <= start+size
+  int r = 0;
+  for (ptrdiff_t k = 0; k <= next_ranges[id].size; k++)
+  {
+    ptrdiff_t x = next_ranges[id].start + k;
+    while(x > ranges[r].start + ranges[r].size) r++;
+    dst[k] = src[ranges[r].l_start + x - ranges[r].start];
+#ifdef ARGSORT
+    idx_dst[k] = idx_src[ranges[r].l_start + x - ranges[r].start];
+#endif
+  }
+#ifdef REBALANCE
+  times[id].usecs = 0;
+#endif
+}
+
+
+/**
+ * 
+ * Switches to the next layout, called by one thread once all the regions are migrated.
+ * 
+*/
+void switchLayout() {
+  ranges.swap(next_ranges);
+  next_ranges.resize(nw);
+  std::swap(buffers[0], buffers[1]);
+#ifdef ARGSORT
+  std::swap(idx_buffers[0], idx_buffers[1]);
+#endif
+}
+#endif
+
+
+#ifdef SHRINK
+/**
+ * 
+ * A worker can be retired when neither it nor its neighbours had swaps in the last SHRINK iterations.
+ * @param id id of the worker
+ * 
+*/
+bool retirable(int id) {
+  return quiet[id].iters >= SHRINK &&
+         (id == 0 || quiet[id-1].iters >= SHRINK) &&
+         (id == nw-1 || quiet[id+1].iters >= SHRINK);
+}
+
+
+/**
+ * 
+ * Checks if the team has to be replaced by a smaller one, i.e. if at least
+ * a quarter of the workers can be retired. Every thread takes the same decision,
+ * since counters are not written again until the next odd phase.
+ * 
+*/
+bool shrinking() {
+  int retired = 0;
+  for (int i = 0; i < nw; i++)
+  {
+    retired += retirable(i);
+  }
+  return 4*retired >= nw && retired > 0;
+}
+
+
+/**
+ * 
+ * Prepares the next team after the current one stopped: each retired region is merged
+ * into the closest active one on its left (the first active one for the leading regions).
+ * The new team migrates the merged regions to the spare layout before sorting.
+ * 
+*/
+void shrinkTeam() {
+  ptrdiff_t m = ranges.back().end + 1;
+
+  next_ranges.clear();
+  for (int i = 0; i < nw; i++)
+  {
+    if(retirable(i)) continue;
+
+    Range range;
+    range.start = (next_ranges.empty() ? 0 : ranges[i].start);
+    if(!next_ranges.empty()) next_ranges.back().end = range.start - 1;
+    next_ranges.push_back(range);
+  }
+  next_ranges.back().end = m-1;
+  layoutRanges();
+
+  nw = next_ranges.size();
+  delete(bar1);
+  delete(bar2);
+  bar1 = new Barrier(nw);
+  bar2 = new Barrier(nw);
+  quiet = std::vector<WorkerQuiet>(nw);
+#ifdef REBALANCE
+  delete(bar3);
+  bar3 = new Barrier(nw);
+  times = std::vector<WorkerTime>(nw);
+#endif
+  cond = 0;
+  teams++;
+}
+#endif
+
+
+#ifdef PREPASS
+/**
+ * 
+ * Compare-exchanges between logical indexes x and x+g, for each x in [lo, hi) that belongs
+ * to a block of g elements of the given parity. Each slice is split where it crosses a region,
+ * reading and writing border elements in the region on their left, where they are taken from
+ * by the next even phase (start < x <= start+size).
+ * @param vec    padded vector
+ * @param g      gap
+ * @param parity 0 for even blocks, 1 for odd blocks
+ * @param lo     first logical index of the worker
+ * @param hi     end of the logical indexes of the worker
+ * 
+*/
+void gapStage(int16_t *vec, ptrdiff_t g, int parity, ptrdiff_t lo, ptrdiff_t hi) {
+  ptrdiff_t m = ranges.back().end + 1;
+#ifdef ARGSORT
+  auto idx = indexes->data();
+#endif
+  int r1 = 0, r2 = 0;   // Regions of the two slices, only moving forward
+
+  ptrdiff_t off = parity*g;
+  for (ptrdiff_t j = off + (std::max<ptrdiff_t>(lo - off, 0) / (2*g)) * (2*g); j < hi && j + g < m; j += 2*g)
+  {
+    ptrdiff_t from = std::max(j, lo);
+    ptrdiff_t to = std::min(std::min(j + g, hi), m - g);
+
+    while(from < to) {
+      while(from > ranges[r1].start + ranges[r1].size) r1++;
+      while(from + g > ranges[r2].start + ranges[r2].size) r2++;
+
+      ptrdiff_t len = std::min(to, std::min(ranges[r1].start + ranges[r1].size, ranges[r2].start + ranges[r2].size - g) + 1) - from;
+      ptrdiff_t p = ranges[r1].l_start + from - ranges[r1].start;
+      ptrdiff_t q = ranges[r2].l_start + from + g - ranges[r2].start;
+
+      #pragma GCC ivdep
+      for (ptrdiff_t i = 0; i < len; i++)
+      {
+        int16_t first = vec[p+i];
+        int16_t second = vec[q+i];
+
+        int16_t temp = first;
+        first = ( (first > second) ? second : first );
+        second = ( (temp > second) ? temp : second);
+
+        vec[p+i] = first;
+        vec[q+i] = second;
+#ifdef ARGSORT
+        ptrdiff_t mask = -(ptrdiff_t)(temp > first);
+        ptrdiff_t diff = (idx[p+i] ^ idx[q+i]) & mask;
+        idx[p+i] ^= diff;
+        idx[q+i] ^= diff;
+#endif
+      }
+      from += len;
+    }
+  }
+}
+
+
+/**
+ * 
+ * Pre-conditioning passes, with gaps shrinking by 1.3 down to 2 as in the sequential version.
+ * Barriers are used as in the phases (dec, dec, inc, inc) and left ready for the first phase.
+ * @param vec padded vector
+ * @param id  id of this thread
+ * 
+*/
+void gapPasses(int16_t *vec, int id) {
+  ptrdiff_t m = ranges.back().end + 1;
+  ptrdiff_t lo = ranges[id].start;
+  ptrdiff_t hi = ranges[id].end + 1;
+  int s = 0;
+
+  auto sync = [&]() {
+    Barrier &b = (s % 2 == 0 ? *bar1 : *bar2);
+    if((s / 2) % 2 == 0) b.dec_wait();
+    else b.inc_wait();
+    s++;
+  };
+
+  auto t_s = hrclock::now();
+  for (ptrdiff_t g = (ptrdiff_t)(m / 1.3); g > 1; g = (ptrdiff_t)(g / 1.3))
+  {
+    gapStage(vec, g, 0, lo, hi);
+    sync();
+    gapStage(vec, g, 1, lo, hi);
+    sync();
+    if(id == 0) gaps++;
+  }
+  while(s % 4 != 0) sync();
+
+  if(id == 0) prepass = std::chrono::duration_cast<std::chrono::microseconds>(hrclock::now()-t_s).count();
+}
+#endif
+
+
 /**
  * 
  * Thread function used for sorting the region specified in the assigned range.
@@ -123,28 +503,48 @@ void printVector(std::vector<int16_t> *vec) {
  * @param id      id of this thread
  * 
 */
-void oddEvenSort(std::vector<int16_t> *to_sort, Range range, int id) {
-  int l_start = range.l_start;
-  int size = range.size;
+void oddEvenSort(Buffer<int16_t> *to_sort, Range range, int id) {
+  ptrdiff_t l_start = range.l_start;
+  ptrdiff_t size = range.size;
 
   auto local_vec = &(*to_sort)[l_start];
-  auto &vec = *to_sort;
+  auto vec = to_sort->data();
+#ifdef ARGSORT
+  auto idx = indexes->data();
+  auto local_idx = &idx[l_start];
+#endif
 
   auto& b1 = *bar1;
   auto& b2 = *bar2;
 
-  while(true) {
+#ifdef REBALANCE
+  long iter = 0;
+  auto &time = times[id].usecs;
+#endif
 
-    int16_t test = 0;   // Auxiliary variable to check swaps.
+#ifdef SPECULATE
+  long iter = 0;
+  int period = 1;       // Iterations between two termination checks
+  long next_check = 1;
+  int round = 0;        // Current check, to choose barrier and counter
+#endif
 
-    // Prepare for even phase, updates first/last element
-    if(id!=0) {
-      local_vec[0] = vec[ranges[id-1].l_start + ranges[id-1].size];
-    }
+#ifdef DIRTY
+  // Swaps of each block in the previous and in the current phase,
+  // with an always dirty block on both sides
+  ptrdiff_t blocks = (size + DIRTY - 1) / DIRTY;
+  std::vector<int16_t> last(blocks+2, 1);
+  std::vector<int16_t> curr(blocks+2, 1);
+  int forced = 2;     // Phases sorting all the blocks, so that each pair is checked once
+#endif
+
+  // Sorts the pairs of the region starting at lo+phase, lo+phase+2, ... before hi,
+  // returns 1 if at least one pair was swapped
+  auto sortPairs = [&](ptrdiff_t lo, ptrdiff_t hi, int phase) {
+    int16_t swaps = 0;
 
-    // Phase 1: even phase
     #pragma GCC ivdep
-    for (int i = 0; i < size; i+=2)
+    for (ptrdiff_t i = lo+phase; i < hi; i+=2)
     {
       int16_t first = local_vec[i];
       int16_t second = local_vec[i+1];
@@ -156,45 +556,233 @@ void oddEvenSort(std::vector<int16_t> *to_sort, Range range, int id) {
 
       local_vec[i] = first;
       local_vec[i+1] = second;
+#ifdef ARGSORT
+      // Indexes follow the keys, using the comparison as mask
+      ptrdiff_t mask = -(ptrdiff_t)(temp > first);
+      ptrdiff_t diff = (local_idx[i] ^ local_idx[i+1]) & mask;
+      local_idx[i] ^= diff;
+      local_idx[i+1] ^= diff;
+#endif
+
+      swaps = swaps | (temp > first);
+    }
+    return swaps;
+  };
+
+#ifdef DIRTY
+  // Sorts the pairs of the blocks that changed, together with their neighbours,
+  // in the previous phase, returns 1 if at least one pair was swapped
+  auto sortBlocks = [&](int phase) {
+    int16_t swaps = 0;
+
+    for (ptrdiff_t b = 0; b < blocks; b++)
+    {
+      if(!forced && !(last[b] | last[b+1] | last[b+2])) {
+        curr[b+1] = 0;
+        continue;
+      }
+      ptrdiff_t lo = b*DIRTY;
+      curr[b+1] = sortPairs(lo, std::min(lo+DIRTY, size), phase);
+      swaps = swaps | curr[b+1];
+    }
+    last.swap(curr);
+    forced -= (forced > 0);
+    return swaps;
+  };
+#endif
+
+#if defined(REBALANCE) || defined(SHRINK)
+  // Reloads the assigned region after a layout switch
+  auto reload = [&]() {
+    size = ranges[id].size;
+    vec = buffers[0]->data();
+    local_vec = &vec[ranges[id].l_start];
+#ifdef ARGSORT
+    idx = idx_buffers[0]->data();
+    local_idx = &idx[ranges[id].l_start];
+#endif
+#ifdef DIRTY
+    // Blocks of the new region are all dirty
+    blocks = (size + DIRTY - 1) / DIRTY;
+    last.assign(blocks+2, 1);
+    curr.assign(blocks+2, 1);
+    forced = 2;
+#endif
+  };
+#endif
+
+#ifdef PREPASS
+#ifdef SHRINK
+  if(teams == 1)
+#endif
+  gapPasses(vec, id);
+#endif
+
+#ifdef SHRINK
+  // A smaller team first merges the regions of the retired workers,
+  // the barriers complete a whole cycle so that the loop starts as usual
+  if(teams > 1) {
+    migrate(id);
+    b1.dec_wait();
+    if(id == 0) switchLayout();
+    b2.dec_wait();
+    b1.inc_wait();
+    b2.inc_wait();
+    reload();
+  }
+#endif
 
+  while(true) {
+
+    int16_t test = 0;   // Auxiliary variable to check swaps.
+
+#ifdef SPECULATE
+    // The previous worker completed its odd phase
+    if(id!=0) phases[id-1].wait(2*iter);
+#endif
+
+    // Prepare for even phase, updates first/last element
+    if(id!=0) {
+      local_vec[0] = vec[ranges[id-1].l_start + ranges[id-1].size];
+#ifdef ARGSORT
+      local_idx[0] = idx[ranges[id-1].l_start + ranges[id-1].size];
+#endif
     }
+
+#ifdef REBALANCE
+    auto t_s = hrclock::now();
+#endif
+    // Phase 1: even phase
+#ifdef DIRTY
+    test = sortBlocks(0);
+#else
+    test = sortPairs(0, size, 0);
+#endif
+#ifdef SHRINK
+    int16_t moved = test;   // Swaps of the even phase
+#endif
+#ifdef REBALANCE
+    time += std::chrono::duration<double, std::micro>(hrclock::now()-t_s).count();
+#endif
+#ifdef SPECULATE
+    // The next worker completed its even phase
+    phases[id].done = 2*iter + 1;
+    if(id != nw-1) phases[id+1].wait(2*iter + 1);
+#else
     b1.dec_wait();
+#endif
 
     
     if(id != nw-1) {
       int16_t el2 = vec[ranges[id+1].l_start];
       local_vec[size] = el2;
+#ifdef ARGSORT
+      local_idx[size] = idx[ranges[id+1].l_start];
+#endif
     }
 
+#ifdef REBALANCE
+    t_s = hrclock::now();
+#endif
     // Phase 2: odd phase
-    #pragma GCC ivdep
-    for (int i = 1; i < size; i+=2)
-    {
-      int16_t first = local_vec[i];
-      int16_t second = local_vec[i+1];
-
-      int16_t temp = first;
-      first = ( (first > second) ? second : first );
-      second = ( (temp > second) ? temp : second);
-
-      local_vec[i] = first;
-      local_vec[i+1] = second;
-      
-      test = test | (temp > first);
+#ifdef DIRTY
+    test = sortBlocks(1);
+#else
+    test = sortPairs(0, size, 1);
+#endif
+#ifdef REBALANCE
+    time += std::chrono::duration<double, std::micro>(hrclock::now()-t_s).count();
+#endif
+#ifdef SHRINK
+    quiet[id].iters = ((moved | test) ? 0 : quiet[id].iters + 1);
+#endif
+#ifdef SPECULATE
+    phases[id].done = 2*iter + 2;
+    if(++iter < next_check) continue;
+
+    // Termination check: barriers are used as in the phases (dec, dec, inc, inc),
+    // the counter of the check after the next one is reset once everybody read it
+    checks[round % 3] += test;
+    Barrier &b = (round % 2 == 0 ? b1 : b2);
+    if((round / 2) % 2 == 0) b.dec_wait();
+    else b.inc_wait();
+
+    int active = checks[round % 3];
+    if(active == 0) break;
+    if(id == 0) {
+      checks[(round + 2) % 3] = 0;
+      spec_checks++;
     }
+    round++;
+
+    period = (4*active > nw ? std::min(2*period, SPECULATE) : std::max(period/2, 1));
+    next_check = iter + period;
+#else
     cond += test;
     b2.dec_wait();
 
     if(cond == 0) break;
+#ifdef SHRINK
+    // The team stops, main hands the remaining phases to a smaller one
+    if(shrinking()) break;
+#endif
+
+#ifdef REBALANCE
+    bool rebalancing = (++iter % REBALANCE == 0);
+    if(rebalancing && id == 0) computeRanges();
+#endif
 
     // Reset barriers
     b1.inc_wait();
+#ifdef REBALANCE
+    if(rebalancing) migrate(id);
+#endif
     b2.inc_wait();
 
+#ifdef REBALANCE
+    // Switch to the new layout and reload assigned region
+    if(rebalancing) {
+      if(id == 0) switchLayout();
+      ((iter / REBALANCE) % 2 ? bar3->dec_wait() : bar3->inc_wait());
+      reload();
+    }
+#endif
+
     cond=0;
+#endif
   }
 }
 
+/**
+ * 
+ * Removes padding and duplicated border elements once sorted, moving each region
+ * to its logical position in place, with a thread for each region.
+ * @param vec padded vector, resized to the vector length
+ * 
+*/
+template<typename V>
+void compact(V *vec) {
+  ptrdiff_t m = ranges.back().end + 1;
+  Barrier bar(nw);
+  std::vector<std::thread> tids;
+
+  for (int i = 0; i < nw; i++) {
+    tids.push_back(std::thread([&, i]() {
+      ptrdiff_t n = ranges[i].size + (i == nw-1 ? 1 : 0);
+      std::vector<typename V::value_type> tail;
+
+      saveTail(*vec, ranges[i], n, tail);
+      bar.dec_wait();
+      moveRegion(*vec, ranges[i], n, tail);
+    }));
+  }
+
+  for(std::thread& t: tids) {
+    t.join();
+  }
+  vec->resize(m);
+}
+
 int main(int argc, char const *argv[])
 {
   
@@ -204,7 +792,7 @@ int main(int argc, char const *argv[])
   }
 
   int seed = atoi(argv[1]);
-  const int m = atoi(argv[2]);
+  const ptrdiff_t m = atoll(argv[2]);
   nw = atoi(argv[3]);
   int size = atoi(argv[4]);
 
@@ -217,18 +805,66 @@ int main(int argc, char const *argv[])
 
   bar1 = new Barrier(nw);
   bar2 = new Barrier(nw);
+#ifdef SPECULATE
+  phases = std::vector<WorkerPhase>(nw);
+#endif
 
   std::vector<std::thread> tids;
-  std::vector<int16_t> *to_sort = new std::vector<int16_t>();
+#ifdef HUGEPAGES
+  prefault_threads = nw;
+#endif
+  Buffer<int16_t> *to_sort = new Buffer<int16_t>();
   assignRanges(m);
+  // Padded vector allocated once, padding takes less than 33 elements per region
+  to_sort->reserve(ranges.back().end + 1 + 33*nw);
   initializeVector(to_sort, seed, max, size);
 
+#if defined(REBALANCE) || defined(SHRINK)
+  // Both layouts must fit any split of the vector
+  c_size = size;
+  next_ranges = std::vector<Range>(nw);
+  buffers[0] = to_sort;
+  buffers[1] = new Buffer<int16_t>(ranges.back().end + 1 + 33*nw);
+  buffers[0]->resize(buffers[1]->size());
+#endif
+#ifdef REBALANCE
+  bar3 = new Barrier(nw);
+  times = std::vector<WorkerTime>(nw);
+#endif
+#ifdef SHRINK
+  quiet = std::vector<WorkerQuiet>(nw);
+#endif
+
+#ifdef ARGSORT
+  indexes = new Buffer<ptrdiff_t>();
+  initializeIndexes(indexes, to_sort->size());
+
+  // Keys in their original order, to check the permutation
+  std::vector<int16_t> keys(ranges.back().end + 1);
+  for (size_t j = 0; j < to_sort->size(); j++)
+  {
+    if((*indexes)[j] >= 0) keys[(*indexes)[j]] = (*to_sort)[j];
+  }
+#if defined(REBALANCE) || defined(SHRINK)
+  idx_buffers[0] = indexes;
+  idx_buffers[1] = new Buffer<ptrdiff_t>(indexes->size());
+#endif
+#endif
+
   int max_threads = std::thread::hardware_concurrency();
 
+  // Memory events of the sort, to compare the allocation modes
+  PerfCounter tlb(PERF_TYPE_HW_CACHE, DTLB_MISSES);
+  PerfCounter faults(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+  tlb.start();
+  faults.start();
   auto start = hrclock::now();
 #ifdef DEBUG
   printVector(to_sort);
 #endif 
+#ifdef SHRINK
+  while(true) {
+#endif
   for (int i = 0; i < nw; i++) {
     tids.push_back(std::thread(oddEvenSort, to_sort, ranges[i], i));
     // Thread pinning
@@ -241,35 +877,82 @@ int main(int argc, char const *argv[])
   for(std::thread& t: tids) {
     t.join();
   }
+#ifdef SHRINK
+    // The team stopped before the end, retired workers are not started again
+    if(cond == 0) break;
+    shrinkTeam();
+    to_sort = buffers[0];
+    tids.clear();
+  }
+#endif
+#if defined(REBALANCE) || defined(SHRINK)
+  // Sorted values are in the last migrated layout
+  to_sort = buffers[0];
+  delete(buffers[1]);
+#ifdef ARGSORT
+  indexes = idx_buffers[0];
+  delete(idx_buffers[1]);
+#endif
+#endif
+#ifdef REBALANCE
+  delete(bar3);
+#endif
 #ifdef DEBUG
   printVector(to_sort);
 #endif
   auto elapsed = hrclock::now() - start;
   auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  long tlb_misses = tlb.stop();
+  long page_faults = faults.stop();
 
   std::cout << "Simulation spent: " << usec << " usecs\n";
+  if(tlb_misses >= 0) std::cout << "dTLB load misses: " << tlb_misses << "\n";
+  if(page_faults >= 0) std::cout << "Page faults: " << page_faults << "\n";
+#ifdef HUGEPAGES
+  std::cout << "Huge pages: " << huge_pages << "\n";
+#endif
+#ifdef SPECULATE
+  std::cout << "Termination checks: " << spec_checks+1 << "\n";
+#endif
+#ifdef PREPASS
+  std::cout << "Pre-pass spent: " << prepass << " usecs, with a total of: " << gaps << " gaps." << "\n";
+#endif
+#ifdef SHRINK
+  std::cout << "Teams: " << teams << ", last one with " << nw << " workers\n";
+#endif
 
-  // Building sorted vector
-  std::vector<int16_t> sorted;
-  for (int i = 0; i < nw; i++)
-  {
-    for (int j = ranges[i].l_start; j < ranges[i].l_start+ranges[i].size; j++)
-    {
-      sorted.push_back((*to_sort)[j]);
-      if(i==nw-1 && j==(ranges[i].l_start+ranges[i].size-1)) sorted.push_back((*to_sort)[j+1]);
-    }
-  }
+  // Removing padding, the sorted vector is built in place
+  start = hrclock::now();
+  compact(to_sort);
+#ifdef ARGSORT
+  compact(indexes);
+#endif
+  elapsed = hrclock::now() - start;
+  usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  std::cout << "Compaction spent: " << usec << " usecs\n";
   #ifdef DEBUG
     std::cout << "Final sorted vector is: ";
-    printVector(&sorted);
+    printVector(to_sort);
   #endif
 
   delete(bar1);
   delete(bar2);
-  delete(to_sort);
 
-  // Checking if it is really sorted
-  assert(std::is_sorted(std::begin(sorted), std::end(sorted)));
+  // Checking that it is a sorted permutation of the input
+  auto &sorted = *to_sort;
+  if(!verifySorted(sorted, nw, input)) return -1;
+#ifdef ARGSORT
+  // Checking that indexes are a permutation and each one points to its own key
+  auto &perm = *indexes;
+  std::vector<bool> seen(sorted.size());
+  for (size_t i = 0; i < sorted.size(); i++)
+  {
+    assert(!seen[perm[i]] && keys[perm[i]] == sorted[i]);
+    seen[perm[i]] = true;
+  }
+  delete(indexes);
+#endif
+  delete(to_sort);
 
   return 0;
 }
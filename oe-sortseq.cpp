@@ -2,6 +2,20 @@
  * 
  * Sequential implementation of Odd-Even sort algorithm.
  * 
+ * When compiled with -DARGSORT, the index of each key is moved together with the key,
+ * giving the permutation that sorts the vector (argsort).
+ * Keys and indexes are kept in separate vectors and indexes are swapped with a mask
+ * computed from the keys comparison, so the loops stay branchless.
+ * 
+ * Vectors of at most NETWORK_MAX elements are sorted by a sorting network
+ * generated at compile time, instead of running the phases.
+ * 
+ * When compiled with -DPREPASS, the phases are preceded by comb sort like passes
+ * at decreasing gaps, leaving each element close to its final position.
+ * 
+ * When compiled with -DUPDATES=k, after sorting a few ticks of k small random updates
+ * are applied to the vector, each one followed by an incremental re-sort.
+ * 
 */
 
 
@@ -10,18 +24,46 @@
 #include <chrono>
 #include <assert.h>
 #include <algorithm>
+#include <numeric>
+
+#include "networks.cpp"
+#include "verify.cpp"
 
 using hrclock = std::chrono::high_resolution_clock;
 using now = std::chrono::_V2::system_clock::time_point;
 
 // Stats counters
-  int phase1 = 0;
-  int n_1 = 0;
-  int phase2 = 0;
-  int n_2 = 0;
-  int overhead = 0;
+  long phase1 = 0;
+  long n_1 = 0;
+  long phase2 = 0;
+  long n_2 = 0;
+  long overhead = 0;
+  long prepass = 0;
+  int gaps = 0;
   now time_s, time_e;
 
+Checksum input;             // Checksum of the generated keys
+
+#ifdef ARGSORT
+std::vector<ptrdiff_t> *indexes;  // Position of each key before sorting
+#endif
+
+#ifdef UPDATES
+#ifdef ARGSORT
+#error "Incremental re-sort does not move the indexes"
+#endif
+const int TICKS = 100;      // Number of ticks of updates
+const int DELTA = 16;       // Maximum change of an updated value
+
+// Window of the vector where compare-exchanges are performed,
+// from the pair (l, l+1) up to the pair (r-1, r)
+struct Window {
+  ptrdiff_t l;
+  ptrdiff_t r;
+  int16_t swaps;
+};
+#endif
+
 
 /**
  * 
@@ -32,12 +74,13 @@ using now = std::chrono::_V2::system_clock::time_point;
  * @param max    max value to be present in the initialized vector
  * 
 */
-void initializeVector(std::vector<int16_t> *vec, int seed, int m, int max) {
+void initializeVector(std::vector<int16_t> *vec, int seed, ptrdiff_t m, int max) {
   srand(seed);
 
-  for (int i = 0; i < m; i++)
+  for (ptrdiff_t i = 0; i < m; i++)
   {
     (*vec)[i] = (int16_t)(rand() % max);
+    input.add((*vec)[i]);
   }
 }
 
@@ -51,7 +94,7 @@ void initializeVector(std::vector<int16_t> *vec, int seed, int m, int max) {
 */
 void printVector(std::vector<int16_t> *vec) {
 
-  for (int i = 0; i < (*vec).size(); i++)
+  for (size_t i = 0; i < (*vec).size(); i++)
   {
     std::cout << (*vec)[i] << " ";
   }
@@ -60,6 +103,60 @@ void printVector(std::vector<int16_t> *vec) {
 }
 
 
+#ifdef PREPASS
+/**
+ * 
+ * Pre-conditioning passes: compare-exchanges between elements at distance g,
+ * with g shrinking by 1.3 down to 2 as in comb sort. For each gap, blocks of g elements
+ * are compared with the following block, first starting from the even blocks and then
+ * from the odd ones, so that each pass is made of independent slices that are vectorized.
+ * Elements end up close to their final position, so few phases are left.
+ * @param to_sort vector to sort
+ * @param m       vector length
+ * 
+*/
+void gapPasses(std::vector<int16_t> *to_sort, ptrdiff_t m) {
+  auto &vec = *to_sort;
+#ifdef ARGSORT
+  auto &idx = *indexes;
+#endif
+
+  for (ptrdiff_t g = (ptrdiff_t)(m / 1.3); g > 1; g = (ptrdiff_t)(g / 1.3))
+  {
+    // Even blocks first, then the odd ones
+    for (int parity = 0; parity < 2; parity++)
+    {
+      for (ptrdiff_t j = parity*g; j + g < m; j += 2*g)
+      {
+        ptrdiff_t to = std::min(j + g, m - g);
+
+        #pragma GCC ivdep
+        for (ptrdiff_t i = j; i < to; i++)
+        {
+          int16_t first = vec[i];
+          int16_t second = vec[i+g];
+
+          int16_t temp = first;
+          first = ( (first > second) ? second : first );
+          second = ( (temp > second) ? temp : second);
+
+          vec[i] = first;
+          vec[i+g] = second;
+#ifdef ARGSORT
+          ptrdiff_t mask = -(ptrdiff_t)(temp > first);
+          ptrdiff_t diff = (idx[i] ^ idx[i+g]) & mask;
+          idx[i] ^= diff;
+          idx[i+g] ^= diff;
+#endif
+        }
+      }
+    }
+    gaps++;
+  }
+}
+#endif
+
+
 /**
  * 
  * Actual implementation of the Odd-Even sort algorithm.
@@ -67,8 +164,24 @@ void printVector(std::vector<int16_t> *vec) {
  * @param m       vector length
  * 
 */
-void oddEvenSort(std::vector<int16_t> *to_sort, int m) {
+void oddEvenSort(std::vector<int16_t> *to_sort, ptrdiff_t m) {
   auto &vec = *to_sort;
+#ifdef ARGSORT
+  auto &idx = *indexes;
+#else
+  // Small vectors are sorted with a fixed number of branchless comparisons
+  if(m <= NETWORK_MAX) {
+    smallSort(vec.data(), m);
+    return;
+  }
+#endif
+
+#ifdef PREPASS
+  time_s = hrclock::now();
+  gapPasses(to_sort, m);
+  time_e = hrclock::now();
+  prepass = std::chrono::duration_cast<std::chrono::microseconds>(time_e-time_s).count();
+#endif
 
   now start = hrclock::now();
   while(true) {
@@ -76,7 +189,7 @@ void oddEvenSort(std::vector<int16_t> *to_sort, int m) {
 
     // Phase 1: even phase
     time_s = hrclock::now();
-    for (int i = 0; i < m-1; i+=2)
+    for (ptrdiff_t i = 0; i < m-1; i+=2)
     {
       int16_t first = vec[i];
       int16_t second = vec[i+1];
@@ -88,6 +201,13 @@ void oddEvenSort(std::vector<int16_t> *to_sort, int m) {
 
       vec[i] = first;
       vec[i+1] = second;
+#ifdef ARGSORT
+      // Indexes follow the keys, using the comparison as mask
+      ptrdiff_t mask = -(ptrdiff_t)(temp > first);
+      ptrdiff_t diff = (idx[i] ^ idx[i+1]) & mask;
+      idx[i] ^= diff;
+      idx[i+1] ^= diff;
+#endif
     }
     time_e = hrclock::now();
     phase1 += std::chrono::duration_cast<std::chrono::microseconds>(time_e-time_s).count();
@@ -95,7 +215,7 @@ void oddEvenSort(std::vector<int16_t> *to_sort, int m) {
     
     // Phase 2: odd phase
     time_s = hrclock::now();
-    for (int i = 1; i < m-1; i+=2)
+    for (ptrdiff_t i = 1; i < m-1; i+=2)
     {
       int16_t first = vec[i];
       int16_t second = vec[i+1];
@@ -106,6 +226,12 @@ void oddEvenSort(std::vector<int16_t> *to_sort, int m) {
 
       vec[i] = first;
       vec[i+1] = second;
+#ifdef ARGSORT
+      ptrdiff_t mask = -(ptrdiff_t)(temp > first);
+      ptrdiff_t diff = (idx[i] ^ idx[i+1]) & mask;
+      idx[i] ^= diff;
+      idx[i+1] ^= diff;
+#endif
 
       // Compatible with SIMD, avoiding type conversion
       test = test | (temp > first);
@@ -124,6 +250,85 @@ void oddEvenSort(std::vector<int16_t> *to_sort, int m) {
 
 }
 
+#ifdef UPDATES
+/**
+ * 
+ * Incremental re-sort of a sorted vector after some of its elements have been modified.
+ * Phases are performed only inside windows around the modified elements: a window grows
+ * by one element on a side each time its border pair is swapped, since the element
+ * may have to move further, and it is dropped after an even and an odd phase without swaps.
+ * Outside the windows the vector is still sorted, so the cost depends on the number
+ * of updates and on how far the updated elements move, not on the vector length.
+ * @param to_sort vector to sort, sorted before the updates
+ * @param m       vector length
+ * @param dirty   indexes of the modified elements
+ * @return number of even/odd iterations performed
+ * 
+*/
+int oddEvenResort(std::vector<int16_t> *to_sort, ptrdiff_t m, std::vector<ptrdiff_t> dirty) {
+  auto &vec = *to_sort;
+  std::vector<Window> windows, next;
+  int iterations = 0;
+
+  if(m < 2) return 0;
+
+  // Each window starts with the two pairs of a modified element, overlapping ones are merged
+  std::sort(std::begin(dirty), std::end(dirty));
+  for(ptrdiff_t d: dirty) {
+    ptrdiff_t l = std::max<ptrdiff_t>(d-1, 0);
+    ptrdiff_t r = std::min(d+1, m-1);
+    if(!windows.empty() && l <= windows.back().r) windows.back().r = std::max(windows.back().r, r);
+    else windows.push_back({l, r, 0});
+  }
+
+  while(!windows.empty()) {
+
+    // Phase 1 (even) and phase 2 (odd), on pairs starting at indexes of the same parity
+    for (int phase = 0; phase < 2; phase++)
+    {
+      for(auto &w: windows) {
+        ptrdiff_t start = w.l + (w.l % 2 != phase);
+        bool grow_l = (start == w.l && vec[w.l] > vec[w.l+1]);
+        bool grow_r = ((w.r-1) % 2 == phase && vec[w.r-1] > vec[w.r]);
+        int16_t test = 0;   // Auxiliary variable to check swaps.
+
+        #pragma GCC ivdep
+        for (ptrdiff_t i = start; i < w.r; i+=2)
+        {
+          int16_t first = vec[i];
+          int16_t second = vec[i+1];
+
+          int16_t temp = first;
+          first = ( (first > second) ? second : first );
+          second = ( (temp > second) ? temp : second);
+
+          vec[i] = first;
+          vec[i+1] = second;
+
+          test = test | (temp > first);
+        }
+        w.swaps |= test;
+
+        if(grow_l && w.l > 0) w.l--;
+        if(grow_r && w.r < m-1) w.r++;
+      }
+    }
+    iterations++;
+
+    // Converged windows are dropped, windows grown into each other are merged
+    next.clear();
+    for(auto &w: windows) {
+      if(!w.swaps) continue;
+      if(!next.empty() && w.l <= next.back().r) next.back().r = std::max(next.back().r, w.r);
+      else next.push_back({w.l, w.r, 0});
+    }
+    windows.swap(next);
+  }
+
+  return iterations;
+}
+#endif
+
 int main(int argc, char const *argv[])
 {
   
@@ -133,7 +338,7 @@ int main(int argc, char const *argv[])
   }
 
   int seed = atoi(argv[1]);
-  const int m = atoi(argv[2]);
+  const ptrdiff_t m = atoll(argv[2]);
   
   // Optional value to specify the maximum value
   // that can be present in the array to be sorted.
@@ -145,6 +350,11 @@ int main(int argc, char const *argv[])
 
   std::vector<int16_t> *to_sort = new std::vector<int16_t>(m);
   initializeVector(to_sort, seed, m, max);
+#ifdef ARGSORT
+  std::vector<int16_t> keys(*to_sort);
+  indexes = new std::vector<ptrdiff_t>(m);
+  std::iota(std::begin(*indexes), std::end(*indexes), 0);
+#endif
 
   auto start = hrclock::now();
 #ifdef DEBUG
@@ -158,12 +368,53 @@ int main(int argc, char const *argv[])
   auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
 
   std::cout << "Simulation spent: " << usec << " usecs\n";
-  std::cout << "Average phase1 spent: " << phase1 << " usecs, with a total of: " << n_1 << " phases." << " That is: " << (float)phase1/(float)n_1 << " usecs per phase." << "\n";
-  std::cout << "Average phase2 spent: " << phase2 << " usecs, with a total of: " << n_2 << " phases." << " That is: " << (float)phase2/(float)n_2 << " usecs per phase." << "\n";
-  std::cout << "OH per cicle: " << (float)overhead/(float)(n_1*2) << std::endl;
+  if(n_1 == 0) {
+    std::cout << "Sorted by network, no phases." << "\n";
+  }
+  else {
+    std::cout << "Average phase1 spent: " << phase1 << " usecs, with a total of: " << n_1 << " phases." << " That is: " << (float)phase1/(float)n_1 << " usecs per phase." << "\n";
+    std::cout << "Average phase2 spent: " << phase2 << " usecs, with a total of: " << n_2 << " phases." << " That is: " << (float)phase2/(float)n_2 << " usecs per phase." << "\n";
+    std::cout << "OH per cicle: " << (float)overhead/(float)(n_1*2) << std::endl;
+  }
+#ifdef PREPASS
+  std::cout << "Pre-pass spent: " << prepass << " usecs, with a total of: " << gaps << " gaps." << "\n";
+#endif
+
+  // Checking that it is a sorted permutation of the input
+  if(!verifySorted(*to_sort, 1, input)) return -1;
 
-  // Checking if it is really sorted
-  assert(std::is_sorted(std::begin(*to_sort), std::end(*to_sort)));
+#ifdef UPDATES
+  // Ticks of small random updates, each one re-sorted incrementally,
+  // an empty vector has nothing to update
+  long resort_usecs = 0;
+  long iterations = 0;
+  for (int t = 0; m > 0 && t < TICKS; t++)
+  {
+    std::vector<ptrdiff_t> dirty(UPDATES);
+    for(ptrdiff_t &d: dirty) {
+      d = ((ptrdiff_t)rand() * RAND_MAX + rand()) % m;
+      int value = (*to_sort)[d] + rand() % (2*DELTA+1) - DELTA;
+      (*to_sort)[d] = (int16_t)std::min(std::max(value, 0), max-1);
+    }
+
+    start = hrclock::now();
+    iterations += oddEvenResort(to_sort, m, dirty);
+    resort_usecs += std::chrono::duration_cast<std::chrono::microseconds>(hrclock::now() - start).count();
+
+    assert(std::is_sorted(std::begin(*to_sort), std::end(*to_sort)));
+  }
+  std::cout << "Resort spent: " << (float)resort_usecs/TICKS << " usecs per tick of " << UPDATES << " updates, with " << (float)iterations/TICKS << " iterations per tick." << "\n";
+#endif
+#ifdef ARGSORT
+  // Checking that indexes are a permutation and each one points to its own key
+  std::vector<bool> seen(m);
+  for (ptrdiff_t i = 0; i < m; i++)
+  {
+    assert(!seen[(*indexes)[i]] && keys[(*indexes)[i]] == (*to_sort)[i]);
+    seen[(*indexes)[i]] = true;
+  }
+  delete(indexes);
+#endif
 
   delete(to_sort);
 
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+
+// Point-to-point channels between neighbour ranks.
+// Each rank process attaches to its own channels before using them.
+class Transport {
+  public:
+    virtual ~Transport() {}
+
+    virtual void attach(int rank) = 0;
+    virtual void send(int to, const void *buf, size_t bytes) = 0;
+    virtual void recv(int from, void *buf, size_t bytes) = 0;
+};
+
+
+// Single producer, single consumer ring buffer,
+// head and tail on different cache lines to avoid false sharing
+struct Channel {
+  static const size_t CAP = 1 << 16;
+
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) char data[CAP];
+};
+
+
+// Transport over a POSIX shared memory segment,
+// with two channels (one per direction) for each pair of neighbours.
+// The segment is created by the launching process and inherited by the ranks it forks
+class ShmTransport : public Transport {
+  private:
+    int np, rank;
+    Channel *channels;
+
+    // Channel 2r goes from r to r+1, channel 2r+1 from r+1 to r
+    Channel &link(int from, int to) {
+      return (from < to ? channels[2*from] : channels[2*to+1]);
+    }
+
+  public:
+    ShmTransport(int np) : np(np), rank(-1) {
+      std::string name = "/oe-sort-" + std::to_string(getpid());
+      size_t bytes = sizeof(Channel) * 2 * np;
+
+      int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_EXCL, 0600);
+      if(fd < 0 || ftruncate(fd, bytes) < 0) {
+        perror("shm_open");
+        exit(-1);
+      }
+      void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if(mem == MAP_FAILED) {
+        perror("mmap");
+        exit(-1);
+      }
+      // Mapping is inherited by the forked ranks, name is no longer needed
+      close(fd);
+      shm_unlink(name.c_str());
+
+      channels = (Channel*) mem;
+      for (int i = 0; i < 2*np; i++)
+      {
+        new (&channels[i]) Channel();
+      }
+    }
+
+    ~ShmTransport() {
+      munmap(channels, sizeof(Channel) * 2 * np);
+    }
+
+    void attach(int r) {
+      rank = r;
+    }
+
+    void send(int to, const void *buf, size_t bytes) {
+      Channel &ch = link(rank, to);
+      auto src = (const char*) buf;
+
+      while(bytes > 0) {
+        size_t tail = ch.tail.load(std::memory_order_relaxed);
+        size_t space;
+        while((space = Channel::CAP - (tail - ch.head.load(std::memory_order_acquire))) == 0) {}
+
+        size_t n = std::min(std::min(space, bytes), Channel::CAP - tail % Channel::CAP);
+        memcpy(&ch.data[tail % Channel::CAP], src, n);
+        ch.tail.store(tail + n, std::memory_order_release);
+
+        src += n;
+        bytes -= n;
+      }
+    }
+
+    void recv(int from, void *buf, size_t bytes) {
+      Channel &ch = link(from, rank);
+      auto dst = (char*) buf;
+
+      while(bytes > 0) {
+        size_t head = ch.head.load(std::memory_order_relaxed);
+        size_t avail;
+        while((avail = ch.tail.load(std::memory_order_acquire) - head) == 0) {}
+
+        size_t n = std::min(std::min(avail, bytes), Channel::CAP - head % Channel::CAP);
+        memcpy(dst, &ch.data[head % Channel::CAP], n);
+        ch.head.store(head + n, std::memory_order_release);
+
+        dst += n;
+        bytes -= n;
+      }
+    }
+};
+
+
+// Transport over TCP connections, ranks can run on different hosts.
+// Rank r listens on port base+r of its host and connects to the rank on its right,
+// each rank opens its own connections when attached.
+class TcpTransport : public Transport {
+  private:
+    int np, rank;
+    std::vector<std::string> hosts;   // Host of each rank
+    int base;                         // Port of rank 0
+    int left = -1, right = -1;        // Connections to neighbours
+
+    int fd(int other) {
+      return (other < rank ? left : right);
+    }
+
+    // Connects to the rank on the right, retrying until it is listening
+    void connectRight() {
+      addrinfo hints{}, *addr;
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
+      std::string port = std::to_string(base + rank + 1);
+      if(getaddrinfo(hosts[rank+1].c_str(), port.c_str(), &hints, &addr) != 0) {
+        std::cerr << "Unknown host: " << hosts[rank+1] << std::endl;
+        exit(-1);
+      }
+
+      for (int attempt = 0; right < 0; attempt++)
+      {
+        right = socket(AF_INET, SOCK_STREAM, 0);
+        if(connect(right, addr->ai_addr, addr->ai_addrlen) < 0) {
+          close(right);
+          right = -1;
+          if(attempt == 1000) {
+            perror("connect");
+            exit(-1);
+          }
+          usleep(10000);
+        }
+      }
+      freeaddrinfo(addr);
+    }
+
+  public:
+    TcpTransport(int np, std::vector<std::string> hosts, int base) : np(np), rank(-1), hosts(hosts), base(base) {}
+
+    ~TcpTransport() {
+      if(left >= 0) close(left);
+      if(right >= 0) close(right);
+    }
+
+    void attach(int r) {
+      rank = r;
+      int one = 1;
+      int listener = -1;
+
+      // Listen first, so that the left neighbour can connect
+      // while this rank is still connecting on its own right
+      if(rank != 0) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(base + rank);
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if(listener < 0 ||
+           setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+           bind(listener, (sockaddr*) &addr, sizeof(addr)) < 0 ||
+           listen(listener, 1) < 0) {
+          perror("bind");
+          exit(-1);
+        }
+      }
+      if(rank != np-1) {
+        connectRight();
+        setsockopt(right, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      }
+      if(rank != 0) {
+        left = accept(listener, nullptr, nullptr);
+        if(left < 0) {
+          perror("accept");
+          exit(-1);
+        }
+        setsockopt(left, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        close(listener);
+      }
+    }
+
+    void send(int to, const void *buf, size_t bytes) {
+      auto src = (const char*) buf;
+      while(bytes > 0) {
+        ssize_t n = write(fd(to), src, bytes);
+        if(n <= 0) {
+          perror("write");
+          exit(-1);
+        }
+        src += n;
+        bytes -= n;
+      }
+    }
+
+    void recv(int from, void *buf, size_t bytes) {
+      auto dst = (char*) buf;
+      while(bytes > 0) {
+        ssize_t n = read(fd(from), dst, bytes);
+        if(n <= 0) {
+          perror("read");
+          exit(-1);
+        }
+        dst += n;
+        bytes -= n;
+      }
+    }
+};
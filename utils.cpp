@@ -1,14 +1,24 @@
 #include <iostream>
 #include <atomic>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 
-// Used to assign ranges to workers
+// Used to assign ranges to workers,
+// 64-bit indexes so that vectors can exceed 2^31 elements
 struct Range {
-  int start;
-  int end;
+  ptrdiff_t start;
+  ptrdiff_t end;
 
-  int l_start;
-  int size;
+  ptrdiff_t l_start;
+  ptrdiff_t size;
 };
 
 
@@ -19,6 +29,33 @@ struct Task {
 
   int phase;
   int16_t test;
+  int iters = 1;    // Iterations to run before reporting, when speculating
+};
+
+
+// Used to measure the time spent in phases
+// by each worker, aligned to avoid false sharing
+struct alignas(64) WorkerTime {
+  double usecs = 0;
+};
+
+
+// Used to count the iterations without swaps
+// of each worker, aligned to avoid false sharing
+struct alignas(64) WorkerQuiet {
+  int iters = 0;
+};
+
+
+// Used to synchronize neighbour workers: number of phases
+// completed by each worker, aligned to avoid false sharing
+struct alignas(64) WorkerPhase {
+  std::atomic<long> done{0};
+
+  // Active wait until at least q phases are completed
+  void wait(long q) {
+    while(done < q) {}
+  }
 };
 
 
@@ -40,4 +77,157 @@ class Barrier {
       k--;
       while(k != 0) {}
     }
-};
\ No newline at end of file
+};
+
+
+// Counts a perf event of the calling thread and of the threads it creates afterwards,
+// once they are joined. Not available when perf events are not permitted or not supported
+class PerfCounter {
+  private:
+    int fd = -1;
+    uint32_t type;
+    uint64_t config;
+
+  public:
+    PerfCounter(uint32_t type, uint64_t config) : type(type), config(config) {}
+
+    void start() {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    // Events since start, -1 if not available
+    long stop() {
+      long count = -1;
+      if(fd < 0) return -1;
+      if(read(fd, &count, sizeof(count)) != sizeof(count)) count = -1;
+      close(fd);
+      fd = -1;
+      return count;
+    }
+};
+
+
+#ifdef HUGEPAGES
+const size_t HUGE_PAGE = 2 << 20;     // Huge page size on x86-64
+int prefault_threads = 1;             // Threads touching new buffers
+const char *huge_pages = "none";      // Pages backing the last buffer
+
+/**
+ * 
+ * Touches every 4 KiB page of a new buffer with nw threads, each one on a contiguous part,
+ * so that page faults are taken before timing. Threads are pinned as the workers,
+ * so each part is placed in the memory close to the worker that will sort it.
+ * @param p     start of the buffer
+ * @param bytes length of the buffer
+ * @param nw    number of threads
+ * 
+*/
+void prefault(char *p, size_t bytes, int nw) {
+  std::vector<std::thread> tids;
+  size_t part = (bytes / nw + 4095) & ~(size_t)4095;
+  int max_threads = std::thread::hardware_concurrency();
+
+  for (int i = 0; i < nw; i++) {
+    tids.push_back(std::thread([=]() {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(i % max_threads, &cpuset);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+
+      for (size_t k = i*part; k < std::min(bytes, (i+1)*part); k += 4096)
+      {
+        p[k] = 0;
+      }
+    }));
+  }
+  for(std::thread& t: tids) {
+    t.join();
+  }
+}
+
+
+// Allocator backing vectors with huge pages: explicit ones (MAP_HUGETLB) if some are
+// reserved, transparent ones (madvise) otherwise. Buffers are prefaulted when allocated,
+// so they should be reserved with their final size
+template<typename T>
+struct HugeAllocator {
+  using value_type = T;
+
+  HugeAllocator() = default;
+  template<typename U> HugeAllocator(const HugeAllocator<U>&) {}
+
+  static size_t length(size_t n) {
+    return (n * sizeof(T) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+  }
+
+  T* allocate(size_t n) {
+    size_t bytes = length(n);
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED) huge_pages = "explicit";
+    else {
+      // Transparent pages only back aligned ranges: one more page is mapped,
+      // then the unaligned head and the slack at the end are unmapped
+      char *raw = (char*) mmap(nullptr, bytes + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(raw == MAP_FAILED) {
+        perror("mmap");
+        exit(-1);
+      }
+      char *start = (char*) (((uintptr_t) raw + HUGE_PAGE - 1) & ~(uintptr_t) (HUGE_PAGE - 1));
+      if(start != raw) munmap(raw, start - raw);
+      munmap(start + bytes, raw + HUGE_PAGE - start);
+      p = start;
+      huge_pages = (madvise(p, bytes, MADV_HUGEPAGE) == 0 ? "transparent" : "none");
+    }
+    prefault((char*) p, bytes, prefault_threads);
+    return (T*) p;
+  }
+
+  // Only the aligned range is left mapped, so p and length(n) are its real base and length
+  void deallocate(T *p, size_t n) {
+    munmap(p, length(n));
+  }
+};
+
+template<typename T, typename U>
+bool operator==(const HugeAllocator<T>&, const HugeAllocator<U>&) { return true; }
+
+template<typename T, typename U>
+bool operator!=(const HugeAllocator<T>&, const HugeAllocator<U>&) { return false; }
+
+// Vectors holding the elements being sorted
+template<typename T>
+using Buffer = std::vector<T, HugeAllocator<T>>;
+#else
+template<typename T>
+using Buffer = std::vector<T>;
+#endif
+
+
+// Data TLB load misses
+const uint64_t DTLB_MISSES = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+
+// Used to remove the padding once sorted: the n elements of each region are moved to
+// their logical position, in two steps separated by a barrier. First each region saves
+// its elements lying past the start of the next region, which the next regions overwrite,
+// then it moves the others left and copies back the saved ones.
+template<typename V, typename T>
+void saveTail(V &vec, const Range &r, ptrdiff_t n, std::vector<T> &tail) {
+  ptrdiff_t kept = std::max<ptrdiff_t>(0, n - (r.l_start - r.start));
+  tail.assign(std::begin(vec) + r.l_start + kept, std::begin(vec) + r.l_start + n);
+}
+
+template<typename V, typename T>
+void moveRegion(V &vec, const Range &r, ptrdiff_t n, const std::vector<T> &tail) {
+  ptrdiff_t kept = n - (ptrdiff_t)tail.size();
+  std::copy(std::begin(vec) + r.l_start, std::begin(vec) + r.l_start + kept, std::begin(vec) + r.start);
+  std::copy(std::begin(tail), std::end(tail), std::begin(vec) + r.start + kept);
+}
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+
+// Mixes the bits of a key, so that different multisets
+// give different sums of the mixed keys
+inline uint64_t mix(int16_t x) {
+  uint32_t h = (uint16_t)x * 0x9E3779B1u;
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  return h;
+}
+
+
+// Order-independent checksum of a multiset of keys,
+// checksums of disjoint parts are combined by adding them
+struct Checksum {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t hash = 0;
+
+  void add(int16_t x) {
+    count++;
+    sum += (uint16_t)x;
+    hash += mix(x);
+  }
+
+  void add(const Checksum &other) {
+    count += other.count;
+    sum += other.sum;
+    hash += other.hash;
+  }
+
+  bool operator==(const Checksum &other) const {
+    return count == other.count && sum == other.sum && hash == other.hash;
+  }
+};
+
+
+/**
+ *
+ * Checks the elements in [lo, hi) of a vector, together with the pair crossing the
+ * lower boundary, and adds them to the checksum.
+ * The loop is branchless, the position is searched only if the chunk is not sorted.
+ * @param vec vector to check
+ * @param lo  first element of the chunk
+ * @param hi  end of the chunk
+ * @param c   checksum of the chunk
+ * @return first index i in the chunk with vec[i-1] > vec[i], -1 if sorted
+ *
+*/
+ptrdiff_t verifyChunk(const int16_t *vec, ptrdiff_t lo, ptrdiff_t hi, Checksum &c) {
+  if(lo >= hi) return -1;
+
+  // Pair crossing the lower boundary
+  int16_t bad = (lo > 0 && vec[lo-1] > vec[lo]);
+  uint64_t sum = (uint16_t)vec[hi-1];
+  uint64_t hash = mix(vec[hi-1]);
+
+  for (ptrdiff_t i = lo; i < hi-1; i++)
+  {
+    sum += (uint16_t)vec[i];
+    hash += mix(vec[i]);
+    bad = bad | (vec[i] > vec[i+1]);
+  }
+  c.count += hi - lo;
+  c.sum += sum;
+  c.hash += hash;
+
+  if(!bad) return -1;
+  for (ptrdiff_t i = std::max<ptrdiff_t>(lo, 1); i < hi; i++)
+  {
+    if(vec[i-1] > vec[i]) return i;
+  }
+  return -1;
+}
+
+
+/**
+ *
+ * Verifies the sorted vector with nw threads, each one checking a chunk:
+ * the vector must be sorted, also across the chunks, and its checksum
+ * must be the one of the input. Checks do not depend on NDEBUG.
+ * @param vec   sorted vector, without padding
+ * @param nw    number of threads
+ * @param input checksum of the input
+ * @return true if the vector is a sorted permutation of the input
+ *
+*/
+template<typename V>
+bool verifySorted(const V &vec, int nw, const Checksum &input) {
+  auto start = std::chrono::high_resolution_clock::now();
+  ptrdiff_t m = vec.size();
+  std::vector<Checksum> sums(nw);
+  std::vector<ptrdiff_t> unsorted(nw, -1);
+  std::vector<std::thread> tids;
+
+  for (int i = 0; i < nw; i++) {
+    tids.push_back(std::thread([&, i]() {
+      ptrdiff_t lo = m / nw * i + std::min<ptrdiff_t>(i, m % nw);
+      ptrdiff_t hi = lo + m / nw + (i < m % nw ? 1 : 0);
+      unsorted[i] = verifyChunk(vec.data(), lo, hi, sums[i]);
+    }));
+  }
+  for(std::thread& t: tids) {
+    t.join();
+  }
+
+  Checksum output;
+  ptrdiff_t first = -1;
+  for (int i = 0; i < nw; i++)
+  {
+    output.add(sums[i]);
+    if(first < 0) first = unsorted[i];
+  }
+
+  auto elapsed = std::chrono::high_resolution_clock::now() - start;
+  auto usec    = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  std::cout << "Verification spent: " << usec << " usecs\n";
+
+  if(first >= 0) {
+    std::cout << "Verification failed: vector not sorted at index " << first << std::endl;
+    return false;
+  }
+  if(!(output == input)) {
+    std::cout << "Verification failed: sorted vector is not a permutation of the input" << std::endl;
+    return false;
+  }
+  return true;
+}